@@ -6,6 +6,15 @@
 #define MAX_SLOTS 20
 #define EMPTY -1
 
+// 批次搜尋時一次處理的鍵數
+#define BATCH_GROUP 16
+
+// searchbatch 每次交給 searchBatch 的鍵數上限
+#define BATCH_KEYS 256
+
+// cuckoo 模式插入時最多踢出的次數
+#define MAX_KICKS 500
+
 typedef struct {
     int slots[MAX_SLOTS];
 } Bucket;
@@ -13,6 +22,9 @@ typedef struct {
 Bucket hashTable[MAX_BUCKETS];
 int n, m;
 
+// 1 表示使用兩個候選桶的 cuckoo hashing, 由 "bucket n cuckoo" 開啟
+int cuckooMode = 0;
+
 // 初始化哈希表
 void initializeHashTable() {
     for (int i = 0; i < n; i++) {
@@ -22,8 +34,106 @@ void initializeHashTable() {
     }
 }
 
+// cuckoo 模式的第一個桶, 與線性探測的起點相同
+int cuckooHash1(int key) {
+    return (key % n + n) % n;
+}
+
+// cuckoo 模式的第二個桶, 與第一個桶獨立
+int cuckooHash2(int key) {
+    unsigned int x = (unsigned int)key * 0x9E3779B1U;
+    x ^= x >> 15;
+    x *= 0x85EBCA6BU;
+    x ^= x >> 13;
+    return x % n;
+}
+
+// 鍵在另一個候選桶
+int cuckooAlternate(int key, int bucket) {
+    int h1 = cuckooHash1(key);
+    return bucket == h1 ? cuckooHash2(key) : h1;
+}
+
+// 在桶中找空槽, 沒有則回傳 EMPTY
+int findEmptySlot(int bucket) {
+    for (int i = 0; i < m; i++) {
+        if (hashTable[bucket].slots[i] == EMPTY) {
+            return i;
+        }
+    }
+    return EMPTY;
+}
+
+// cuckoo 插入: 兩個桶都滿時隨機踢出一個鍵到它的另一個桶,
+// 最多 MAX_KICKS 次, 失敗則沿路還原
+void cuckooInsert(int key) {
+    static unsigned int seed = 2463534242U;
+    int pathBucket[MAX_KICKS], pathSlot[MAX_KICKS];
+    int buckets[2] = {cuckooHash1(key), cuckooHash2(key)};
+
+    for (int b = 0; b < 2; b++) {
+        int slot = findEmptySlot(buckets[b]);
+        if (slot != EMPTY) {
+            hashTable[buckets[b]].slots[slot] = key;
+            return;
+        }
+    }
+
+    int current = key;
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    int bucket = buckets[seed & 1];
+    for (int kick = 0; kick < MAX_KICKS; kick++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+
+        // 與桶中隨機一個鍵交換
+        int slot = seed % m;
+        int victim = hashTable[bucket].slots[slot];
+        hashTable[bucket].slots[slot] = current;
+        pathBucket[kick] = bucket;
+        pathSlot[kick] = slot;
+        current = victim;
+
+        bucket = cuckooAlternate(current, bucket);
+        slot = findEmptySlot(bucket);
+        if (slot != EMPTY) {
+            hashTable[bucket].slots[slot] = current;
+            return;
+        }
+    }
+
+    // 還原每一次交換, 表格維持插入前的狀態
+    for (int kick = MAX_KICKS - 1; kick >= 0; kick--) {
+        int victim = hashTable[pathBucket[kick]].slots[pathSlot[kick]];
+        hashTable[pathBucket[kick]].slots[pathSlot[kick]] = current;
+        current = victim;
+    }
+    printf("Hash table is full. Cannot insert key %d.\n", key);
+}
+
+// cuckoo 搜尋: 最多看兩個桶, 回傳 bucket * MAX_SLOTS + slot
+int cuckooFind(int key) {
+    int buckets[2] = {cuckooHash1(key), cuckooHash2(key)};
+    for (int b = 0; b < 2; b++) {
+        for (int i = 0; i < m; i++) {
+            if (hashTable[buckets[b]].slots[i] == key) {
+                return buckets[b] * MAX_SLOTS + i;
+            }
+        }
+    }
+    return EMPTY;
+}
+
 // 插入鍵
 void insertKey(int key) {
+    if (cuckooMode) {
+        cuckooInsert(key);
+        return;
+    }
+
     int hashIndex = key % n;
     int originalIndex = hashIndex;
     do {
@@ -41,6 +151,14 @@ void insertKey(int key) {
 
 // 搜索鍵
 void searchKey(int key) {
+    if (cuckooMode) {
+        int found = cuckooFind(key);
+        if (found != EMPTY) {
+            printf("%d %d\n", found / MAX_SLOTS, found % MAX_SLOTS);
+        }
+        return;
+    }
+
     int hashIndex = key % n;
     int originalIndex = hashIndex;
     do {
@@ -54,8 +172,62 @@ void searchKey(int key) {
     } while (hashIndex != originalIndex);
 }
 
+// 批次搜尋: 先算出所有鍵的桶並預取, 再逐一解析
+// results[i] 為 bucket * MAX_SLOTS + slot, 找不到為 EMPTY
+void searchBatch(int keys[], int count, int results[]) {
+    int hashIndex[BATCH_GROUP];
+
+    for (int base = 0; base < count; base += BATCH_GROUP) {
+        int group = count - base < BATCH_GROUP ? count - base : BATCH_GROUP;
+
+        // 第一階段: 計算桶並預取
+        for (int k = 0; k < group; k++) {
+            if (cuckooMode) {
+                hashIndex[k] = cuckooHash1(keys[base + k]);
+                __builtin_prefetch(&hashTable[cuckooHash2(keys[base + k])]);
+            } else {
+                hashIndex[k] = keys[base + k] % n;
+            }
+            __builtin_prefetch(&hashTable[hashIndex[k]]);
+        }
+
+        // 第二階段: 在已進入快取的桶中解析
+        for (int k = 0; k < group; k++) {
+            int key = keys[base + k];
+            int index = hashIndex[k];
+            if (cuckooMode) {
+                results[base + k] = cuckooFind(key);
+                continue;
+            }
+            results[base + k] = EMPTY;
+            do {
+                int found = 0;
+                for (int i = 0; i < m; i++) {
+                    if (hashTable[index].slots[i] == key) {
+                        results[base + k] = index * MAX_SLOTS + i;
+                        found = 1;
+                        break;
+                    }
+                }
+                if (found) {
+                    break;
+                }
+                index = (index + 1) % n;
+            } while (index != hashIndex[k]);
+        }
+    }
+}
+
 // 刪除鍵
 void deleteKey(int key) {
+    if (cuckooMode) {
+        int found = cuckooFind(key);
+        if (found != EMPTY) {
+            hashTable[found / MAX_SLOTS].slots[found % MAX_SLOTS] = EMPTY;
+        }
+        return;
+    }
+
     int hashIndex = key % n;
     int originalIndex = hashIndex;
     do {
@@ -69,14 +241,41 @@ void deleteKey(int key) {
     } while (hashIndex != originalIndex);
 }
 
+// 丟棄這一行剩下的內容
+void skipLine() {
+    int c;
+    while ((c = getchar()) != '\n' && c != EOF) {
+    }
+}
+
+// 讀取同一行的下一個鍵, 回傳 1
+// 到了行尾 (或遇到不是數字的內容) 時讀掉整行並回傳 0
+int readKeyOnLine(int *key) {
+    int c;
+    do {
+        c = getchar();
+    } while (c == ' ' || c == '\t' || c == '\r');
+    if (c == '\n' || c == EOF) {
+        return 0;
+    }
+    ungetc(c, stdin);
+    if (scanf("%d", key) != 1) {
+        skipLine();
+        return 0;
+    }
+    return 1;
+}
+
 int main() {
-    char input[50];
+    char input[64];
     char command[20];
+    char mode[20] = "";
     int key;
 
-    // 讀取桶數
+    // 讀取桶數, 可選 "bucket n cuckoo" 開啟 cuckoo 模式
     fgets(input, sizeof(input), stdin);
-    sscanf(input, "bucket %d", &n);
+    sscanf(input, "bucket %d %19s", &n, mode);
+    cuckooMode = strcmp(mode, "cuckoo") == 0;
 
     // 讀取槽數
     fgets(input, sizeof(input), stdin);
@@ -85,22 +284,44 @@ int main() {
     // 初始化哈希表
     initializeHashTable();
 
-    while (1) {
-        fgets(input, sizeof(input), stdin);
-        sscanf(input, "%s", command);
-
+    // 指令逐字讀取, 一行多長都不會被截斷
+    while (scanf("%19s", command) == 1) {
         if (strcmp(command, "insert") == 0) {
-            sscanf(input, "%*s %d", &key);
-            insertKey(key);
+            if (scanf("%d", &key) == 1) {
+                insertKey(key);
+            }
         } else if (strcmp(command, "search") == 0) {
-            sscanf(input, "%*s %d", &key);
-            searchKey(key);
+            if (scanf("%d", &key) == 1) {
+                searchKey(key);
+            }
+        } else if (strcmp(command, "searchbatch") == 0) {
+            // searchbatch k1 k2 ... 輸出格式與 search 相同
+            // 每 BATCH_KEYS 個鍵搜尋一次, 鍵數不受限制
+            int keys[BATCH_KEYS], results[BATCH_KEYS], count;
+            int more = 1;
+            while (more) {
+                count = 0;
+                while (count < BATCH_KEYS && (more = readKeyOnLine(&keys[count]))) {
+                    count++;
+                }
+                searchBatch(keys, count, results);
+                for (int k = 0; k < count; k++) {
+                    if (results[k] != EMPTY) {
+                        printf("%d %d\n", results[k] / MAX_SLOTS, results[k] % MAX_SLOTS);
+                    }
+                }
+            }
+
+            // 整行已經讀完
+            continue;
         } else if (strcmp(command, "delete") == 0) {
-            sscanf(input, "%*s %d", &key);
-            deleteKey(key);
+            if (scanf("%d", &key) == 1) {
+                deleteKey(key);
+            }
         } else if (strcmp(command, "exit") == 0) {
             break;
         }
+        skipLine();
     }
 
     return 0;
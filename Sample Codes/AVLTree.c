@@ -1,20 +1,71 @@
 // C program to implement the avl tree
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 
-// AVL Tree node
+// AVL Tree node. The balance factor (height of the left
+// subtree minus height of the right one, -1, 0 or 1) lives
+// in the low 2 bits of the parent pointer: nodes come from
+// malloc, so those bits of their address are always zero.
+// size counts the nodes of the subtree for rank queries and
+// fits next to key, so nodes stay 32 bytes
 struct Node {
     int key;
+    int size;
     struct Node *left;
     struct Node *right;
-    int height;
+    uintptr_t parentAndBalance;
 };
 
-// Function to get height of the node
-int getHeight(struct Node *n) {
+// Function to get the parent of a node
+struct Node *getParent(struct Node *n) {
+    return (struct Node *)(n->parentAndBalance & ~(uintptr_t)3);
+}
+
+// Function to set the parent of a node, keeping its balance
+void setParent(struct Node *n, struct Node *parent) {
+    n->parentAndBalance
+        = (uintptr_t)parent | (n->parentAndBalance & 3);
+}
+
+// Function to get balance factor of a node
+int getBalanceFactor(struct Node *n) {
     if (n == NULL)
         return 0;
-    return n->height;
+    return (int)(n->parentAndBalance & 3) - 1;
+}
+
+// Function to set the balance factor of a node, keeping its
+// parent
+void setBalanceFactor(struct Node *n, int balance) {
+    n->parentAndBalance = (n->parentAndBalance & ~(uintptr_t)3)
+        | (uintptr_t)(balance + 1);
+}
+
+// Function to get the number of nodes in a subtree
+int getSize(struct Node *n) {
+    if (n == NULL)
+        return 0;
+    return n->size;
+}
+
+// Function to recount a node from its children
+void updateSize(struct Node *n) {
+    n->size = getSize(n->left) + getSize(n->right) + 1;
+}
+
+// Function to get height of the node. Heights are not
+// stored, so walk down the taller side
+int getHeight(struct Node *n) {
+    int height = 0;
+    while (n != NULL) {
+        height++;
+        n = getBalanceFactor(n) < 0 ? n->right : n->left;
+    }
+    return height;
 }
 
 // Function to create a new node
@@ -22,107 +73,623 @@ struct Node *createNode(int key) {
     struct Node *node
         = (struct Node *)malloc(sizeof(struct Node));
     node->key = key;
+    node->size = 1;
     node->left = NULL;
     node->right = NULL;
-    node->height = 1; // New node is initially added at leaf
+    node->parentAndBalance = 0;
+    setBalanceFactor(node, 0); // New node is added at leaf
     return node;
 }
 
-// Utility function to get the maximum of two integers
-int getMax(int a, int b) { return (a > b) ? a : b; }
-
-// Function to get balance factor of a node
-int getBalanceFactor(struct Node *n) {
-    if (n == NULL)
-        return 0;
-    return getHeight(n->left) - getHeight(n->right);
+// Function to put newChild where oldChild hangs under parent,
+// or make it the root if parent is NULL
+void replaceChild(struct Node **root, struct Node *parent,
+    struct Node *oldChild, struct Node *newChild) {
+    if (parent == NULL)
+        *root = newChild;
+    else if (parent->left == oldChild)
+        parent->left = newChild;
+    else
+        parent->right = newChild;
+    if (newChild != NULL)
+        setParent(newChild, parent);
 }
 
-// Right rotation function
-struct Node *rightRotate(struct Node *y) {
+// Right rotation function, balance factors are left to the
+// caller
+struct Node *rightRotate(struct Node **root, struct Node *y) {
     struct Node *x = y->left;
     struct Node *T2 = x->right;
 
     // Perform rotation
+    replaceChild(root, getParent(y), y, x);
     x->right = y;
+    setParent(y, x);
     y->left = T2;
+    if (T2 != NULL)
+        setParent(T2, y);
 
-    // Update heights
-    y->height
-        = getMax(getHeight(y->left), getHeight(y->right)) + 1;
-    x->height
-        = getMax(getHeight(x->left), getHeight(x->right)) + 1;
+    // Update sizes
+    x->size = y->size;
+    updateSize(y);
 
     return x;
 }
 
-// Left rotation function
-struct Node *leftRotate(struct Node *x) {
+// Left rotation function, balance factors are left to the
+// caller
+struct Node *leftRotate(struct Node **root, struct Node *x) {
     struct Node *y = x->right;
     struct Node *T2 = y->left;
 
     // Perform rotation
+    replaceChild(root, getParent(x), x, y);
     y->left = x;
+    setParent(x, y);
     x->right = T2;
+    if (T2 != NULL)
+        setParent(T2, x);
 
-    // Update heights
-    x->height
-        = getMax(getHeight(x->left), getHeight(x->right)) + 1;
-    y->height
-        = getMax(getHeight(y->left), getHeight(y->right)) + 1;
+    // Update sizes
+    y->size = x->size;
+    updateSize(x);
 
     return y;
 }
 
-// Function to insert a key into AVL tree
-struct Node *insert(struct Node *node, int key) {
+// Function to rebalance a node whose balance factor has
+// reached 2 or -2 (passed in, it does not fit in 2 bits).
+// Returns the new root of the subtree. Its balance factor is
+// 0 if the subtree ended up one level shorter than before
+// the rotation, which is the case for every insertion and
+// all deletions but the one where the taller child was
+// itself balanced
+struct Node *rebalance(struct Node **root, struct Node *node,
+    int balance) {
+    if (balance > 0) {
+        struct Node *child = node->left;
+        int childBalance = getBalanceFactor(child);
+
+        // Left Left Case (LL rotation)
+        if (childBalance >= 0) {
+            rightRotate(root, node);
+            setBalanceFactor(node, childBalance == 0 ? 1 : 0);
+            setBalanceFactor(child, childBalance == 0 ? -1 : 0);
+            return child;
+        }
+
+        // Left Right Case (LR rotation)
+        struct Node *grand = child->right;
+        int grandBalance = getBalanceFactor(grand);
+        leftRotate(root, child);
+        rightRotate(root, node);
+        setBalanceFactor(node, grandBalance == 1 ? -1 : 0);
+        setBalanceFactor(child, grandBalance == -1 ? 1 : 0);
+        setBalanceFactor(grand, 0);
+        return grand;
+    }
+
+    struct Node *child = node->right;
+    int childBalance = getBalanceFactor(child);
+
+    // Right Right Case (RR rotation)
+    if (childBalance <= 0) {
+        leftRotate(root, node);
+        setBalanceFactor(node, childBalance == 0 ? -1 : 0);
+        setBalanceFactor(child, childBalance == 0 ? 1 : 0);
+        return child;
+    }
+
+    // Right Left Case (RL rotation)
+    struct Node *grand = child->left;
+    int grandBalance = getBalanceFactor(grand);
+    rightRotate(root, child);
+    leftRotate(root, node);
+    setBalanceFactor(node, grandBalance == -1 ? 1 : 0);
+    setBalanceFactor(child, grandBalance == 1 ? -1 : 0);
+    setBalanceFactor(grand, 0);
+    return grand;
+}
+
+// Function to walk up from a subtree that just grew one
+// level taller, fixing balance factors on the way. Returns
+// true if the whole tree grew
+bool retraceGrow(struct Node **root, struct Node *node) {
+    struct Node *parent = getParent(node);
+    while (parent != NULL) {
+        int balance = getBalanceFactor(parent)
+            + (node == parent->left ? 1 : -1);
+
+        // The shorter side caught up, the height is unchanged
+        if (balance == 0) {
+            setBalanceFactor(parent, 0);
+            return false;
+        }
+
+        // 3. A rotation brings the subtree back to the height
+        // it had before it grew, nothing above changes. Only
+        // join can grow a subtree whose children are equally
+        // tall; then the rotated subtree is still one taller
+        if (balance == 2 || balance == -2) {
+            node = rebalance(root, parent, balance);
+            if (getBalanceFactor(node) == 0)
+                return false;
+        } else {
+            setBalanceFactor(parent, balance);
+            node = parent;
+        }
+        parent = getParent(node);
+    }
+    return true;
+}
+
+// Function to insert a key into AVL tree, returns the new
+// root
+struct Node *insert(struct Node *root, int key) {
     // 1. Perform standard BST insertion
+    struct Node *parent = NULL;
+    struct Node **link = &root;
+    while (*link != NULL) {
+        parent = *link;
+        if (key < parent->key)
+            link = &parent->left;
+        else if (key > parent->key)
+            link = &parent->right;
+        else // Equal keys are not allowed in BST
+            return root;
+    }
+    struct Node *node = createNode(key);
+    setParent(node, parent);
+    *link = node;
+    for (struct Node *p = parent; p != NULL; p = getParent(p)) {
+        p->size++;
+    }
+
+    // 2. Walk back up while the subtree that got the node
+    // grew taller
+    retraceGrow(&root, node);
+
+    return root;
+}
+
+// Function to delete a key from AVL tree, returns the new
+// root
+struct Node *deleteKey(struct Node *root, int key) {
+    struct Node *node = root;
+    while (node != NULL && node->key != key) {
+        node = key < node->key ? node->left : node->right;
+    }
     if (node == NULL)
-        return createNode(key);
+        return root;
 
-    if (key < node->key)
-        node->left = insert(node->left, key);
-    else if (key > node->key)
-        node->right = insert(node->right, key);
-    else // Equal keys are not allowed in BST
-        return node;
+    // A node with two children takes the key of its in-order
+    // successor, which is then removed instead
+    if (node->left != NULL && node->right != NULL) {
+        struct Node *successor = node->right;
+        while (successor->left != NULL) {
+            successor = successor->left;
+        }
+        node->key = successor->key;
+        node = successor;
+    }
 
-    // 2. Update height of this ancestor node
-    node->height = 1
-        + getMax(getHeight(node->left),
-            getHeight(node->right));
+    // The node has at most one child, which takes its place
+    struct Node *parent = getParent(node);
+    bool fromLeft = parent != NULL && parent->left == node;
+    replaceChild(&root, parent, node,
+        node->left != NULL ? node->left : node->right);
+    free(node);
+    for (struct Node *p = parent; p != NULL; p = getParent(p)) {
+        p->size--;
+    }
 
-    // 3. Get the balance factor of this ancestor node to
-    // check whether this node became unbalanced
-    int balance = getBalanceFactor(node);
+    // Walk back up while the subtree that lost the node got
+    // shorter
+    while (parent != NULL) {
+        int balance = getBalanceFactor(parent) + (fromLeft ? -1 : 1);
+        struct Node *grand = getParent(parent);
+        bool parentIsLeft = grand != NULL && grand->left == parent;
 
-    // 4. If the node becomes unbalanced, then there are 4
-    // cases
+        // The taller side got shorter, the height is unchanged
+        if (balance == 1 || balance == -1) {
+            setBalanceFactor(parent, balance);
+            break;
+        }
+        if (balance == 0) {
+            setBalanceFactor(parent, 0);
+        } else if (getBalanceFactor(rebalance(&root, parent, balance))
+            != 0) {
+            break;
+        }
+        fromLeft = parentIsLeft;
+        parent = grand;
+    }
 
-    // Left Left Case (LL rotation)
-    if (balance > 1 && key < node->left->key)
-        return rightRotate(node);
+    return root;
+}
 
-    // Right Right Case (RR rotation)
-    if (balance < -1 && key > node->right->key)
-        return leftRotate(node);
+// Function to search a key in AVL tree
+bool search(struct Node *root, int key) {
+    while (root != NULL && root->key != key) {
+        root = key < root->key ? root->left : root->right;
+    }
+    return root != NULL;
+}
 
-    // Left Right Case (LR rotation)
-    if (balance > 1 && key > node->left->key) {
-        node->left = leftRotate(node->left);
-        return rightRotate(node);
+// Function to find the k-th smallest key (k from 1), NULL if
+// the tree has fewer than k keys
+struct Node *selectKth(struct Node *root, int k) {
+    while (root != NULL) {
+        int leftSize = getSize(root->left);
+        if (k <= leftSize) {
+            root = root->left;
+        } else if (k == leftSize + 1) {
+            return root;
+        } else {
+            k -= leftSize + 1;
+            root = root->right;
+        }
     }
+    return NULL;
+}
 
-    // Right Left Case (RL rotation)
-    if (balance < -1 && key < node->right->key) {
-        node->right = rightRotate(node->right);
-        return leftRotate(node);
+// Function to count the keys smaller than key (orEqual:
+// smaller or equal)
+int countBelow(struct Node *root, int key, bool orEqual) {
+    int count = 0;
+    while (root != NULL) {
+        if (root->key < key || (orEqual && root->key == key)) {
+            count += getSize(root->left) + 1;
+            root = root->right;
+        } else {
+            root = root->left;
+        }
     }
+    return count;
+}
 
-    // Return the (unchanged) node pointer
+// Function to get the rank of a key: the number of keys
+// smaller than it, so selectKth(rank(key) + 1) is key when
+// key is in the tree
+int rank(struct Node *root, int key) {
+    return countBelow(root, key, false);
+}
+
+// Function to count the keys in [lo, hi]
+int countRange(struct Node *root, int lo, int hi) {
+    if (lo > hi)
+        return 0;
+    return countBelow(root, hi, true) - countBelow(root, lo, false);
+}
+
+// Function to free every node of AVL tree
+void freeTree(struct Node *root) {
+    if (root != NULL) {
+        freeTree(root->left);
+        freeTree(root->right);
+        free(root);
+    }
+}
+
+// Function to get the height of a tree of n nodes built by
+// buildSorted: one more than the index of n's highest bit
+int sortedHeight(int n) {
+    int height = 0;
+    while (n > 0) {
+        height++;
+        n >>= 1;
+    }
+    return height;
+}
+
+// Function to build a balanced AVL tree from count strictly
+// increasing keys in O(n). The middle key is the root, the
+// halves differ by at most one key so their heights differ
+// by at most one
+struct Node *buildSorted(const int *keys, int count) {
+    if (count == 0)
+        return NULL;
+    int mid = (count - 1) / 2;
+    struct Node *node = createNode(keys[mid]);
+    node->left = buildSorted(keys, mid);
+    node->right = buildSorted(keys + mid + 1, count - mid - 1);
+    if (node->left != NULL)
+        setParent(node->left, node);
+    if (node->right != NULL)
+        setParent(node->right, node);
+    setBalanceFactor(node,
+        sortedHeight(mid) - sortedHeight(count - mid - 1));
+    node->size = count;
     return node;
 }
 
+// A detached tree with its height. Heights are not stored
+// in the nodes, so the set operations below carry them
+// along to keep join at O(difference in heights)
+struct Tree {
+    struct Node *root;
+    int height;
+};
+
+// Function to detach the left and right subtrees of a tree's
+// root, their heights follow from the root's balance factor
+void detachChildren(struct Tree tree, struct Tree *left,
+    struct Tree *right) {
+    struct Node *node = tree.root;
+    int balance = getBalanceFactor(node);
+    left->root = node->left;
+    left->height = tree.height - (balance < 0 ? 2 : 1);
+    right->root = node->right;
+    right->height = tree.height - (balance > 0 ? 2 : 1);
+    if (left->root != NULL)
+        setParent(left->root, NULL);
+    if (right->root != NULL)
+        setParent(right->root, NULL);
+    node->left = NULL;
+    node->right = NULL;
+}
+
+// Function to hang left and right under mid, whose heights
+// differ by at most one
+struct Tree joinBalanced(struct Tree left, struct Node *mid,
+    struct Tree right) {
+    mid->left = left.root;
+    mid->right = right.root;
+    if (left.root != NULL)
+        setParent(left.root, mid);
+    if (right.root != NULL)
+        setParent(right.root, mid);
+    setParent(mid, NULL);
+    setBalanceFactor(mid, left.height - right.height);
+    updateSize(mid);
+    struct Tree tree = {mid,
+        (left.height > right.height ? left.height : right.height) + 1};
+    return tree;
+}
+
+// Function to join left, mid and right, every key of left
+// smaller than mid's and every key of right larger. The
+// shorter tree and mid replace the first subtree on the
+// facing spine of the taller tree that is at most one level
+// taller than it, which is then retraced like an insertion
+struct Tree join(struct Tree left, struct Node *mid,
+    struct Tree right) {
+    bool intoLeft = left.height > right.height + 1;
+    if (!intoLeft && right.height <= left.height + 1)
+        return joinBalanced(left, mid, right);
+
+    struct Tree tall = intoLeft ? left : right;
+    struct Tree shorter = intoLeft ? right : left;
+    struct Node *parent = NULL;
+    struct Tree sub = tall;
+    while (sub.height > shorter.height + 1) {
+        int balance = getBalanceFactor(sub.root);
+        parent = sub.root;
+        if (intoLeft) {
+            sub.height -= balance > 0 ? 2 : 1;
+            sub.root = sub.root->right;
+        } else {
+            sub.height -= balance < 0 ? 2 : 1;
+            sub.root = sub.root->left;
+        }
+    }
+
+    int added = 1 + getSize(shorter.root);
+    if (intoLeft) {
+        joinBalanced(sub, mid, shorter);
+        parent->right = mid;
+    } else {
+        joinBalanced(shorter, mid, sub);
+        parent->left = mid;
+    }
+    setParent(mid, parent);
+    for (struct Node *p = parent; p != NULL; p = getParent(p)) {
+        p->size += added;
+    }
+
+    // mid's subtree is one level taller than the one it replaced
+    struct Node *root = tall.root;
+    if (retraceGrow(&root, mid))
+        tall.height++;
+    tall.root = root;
+    return tall;
+}
+
+// Function to split a tree around key: below gets the keys
+// smaller than key, above the larger ones. Returns the node
+// holding key, detached, or NULL if key is not in the tree
+struct Node *splitTree(struct Tree tree, int key, struct Tree *below,
+    struct Tree *above) {
+    if (tree.root == NULL) {
+        *below = tree;
+        *above = tree;
+        return NULL;
+    }
+    struct Node *node = tree.root;
+    struct Tree left, right, rest;
+    detachChildren(tree, &left, &right);
+
+    if (key == node->key) {
+        *below = left;
+        *above = right;
+        return node;
+    }
+    struct Node *found;
+    if (key < node->key) {
+        found = splitTree(left, key, below, &rest);
+        *above = join(rest, node, right);
+    } else {
+        found = splitTree(right, key, &rest, above);
+        *below = join(left, node, rest);
+    }
+    return found;
+}
+
+// Function to detach the node with the largest key, rest
+// gets the other nodes
+struct Node *splitLast(struct Tree tree, struct Tree *rest) {
+    struct Node *node = tree.root;
+    struct Tree left, right, remaining;
+    detachChildren(tree, &left, &right);
+    if (right.root == NULL) {
+        *rest = left;
+        return node;
+    }
+    struct Node *last = splitLast(right, &remaining);
+    *rest = join(left, node, remaining);
+    return last;
+}
+
+// Function to join two trees without a middle key
+struct Tree join2(struct Tree left, struct Tree right) {
+    if (left.root == NULL)
+        return right;
+    struct Tree rest;
+    struct Node *last = splitLast(left, &rest);
+    return join(rest, last, right);
+}
+
+// Function to get a tree with its height
+struct Tree makeTree(struct Node *root) {
+    struct Tree tree = {root, getHeight(root)};
+    return tree;
+}
+
+// Function to split a tree around key into the keys below
+// and above it, both valid AVL trees. The tree is used up.
+// Returns true if key was in the tree (its node is freed)
+bool split(struct Node *root, int key, struct Node **below,
+    struct Node **above) {
+    struct Tree left, right;
+    struct Node *found = splitTree(makeTree(root), key, &left, &right);
+    free(found);
+    *below = left.root;
+    *above = right.root;
+    return found != NULL;
+}
+
+// Function to merge two trees: split b at a's root key, merge
+// the halves with a's subtrees and join the results under
+// a's root. O(m log(n/m + 1)) for sizes m <= n
+struct Tree unionRec(struct Tree a, struct Tree b) {
+    if (a.root == NULL)
+        return b;
+    if (b.root == NULL)
+        return a;
+    struct Node *mid = a.root;
+    struct Tree aLeft, aRight, bLeft, bRight;
+    detachChildren(a, &aLeft, &aRight);
+    free(splitTree(b, mid->key, &bLeft, &bRight));
+    struct Tree left = unionRec(aLeft, bLeft);
+    struct Tree right = unionRec(aRight, bRight);
+    return join(left, mid, right);
+}
+
+// Function to keep the keys of a that are also in b
+struct Tree intersectionRec(struct Tree a, struct Tree b) {
+    if (a.root == NULL || b.root == NULL) {
+        freeTree(a.root);
+        freeTree(b.root);
+        struct Tree empty = {NULL, 0};
+        return empty;
+    }
+    struct Node *mid = a.root;
+    struct Tree aLeft, aRight, bLeft, bRight;
+    detachChildren(a, &aLeft, &aRight);
+    struct Node *found = splitTree(b, mid->key, &bLeft, &bRight);
+    struct Tree left = intersectionRec(aLeft, bLeft);
+    struct Tree right = intersectionRec(aRight, bRight);
+    if (found != NULL) {
+        free(found);
+        return join(left, mid, right);
+    }
+    free(mid);
+    return join2(left, right);
+}
+
+// Function to keep the keys of a that are not in b
+struct Tree differenceRec(struct Tree a, struct Tree b) {
+    if (a.root == NULL || b.root == NULL) {
+        freeTree(b.root);
+        return a;
+    }
+    struct Node *mid = b.root;
+    struct Tree aLeft, aRight, bLeft, bRight;
+    detachChildren(b, &bLeft, &bRight);
+    free(splitTree(a, mid->key, &aLeft, &aRight));
+    free(mid);
+    struct Tree left = differenceRec(aLeft, bLeft);
+    struct Tree right = differenceRec(aRight, bRight);
+    return join2(left, right);
+}
+
+// Set operations on whole trees. Both trees are used up and
+// their nodes make up the result
+struct Node *setUnion(struct Node *a, struct Node *b) {
+    return unionRec(makeTree(a), makeTree(b)).root;
+}
+
+struct Node *setIntersection(struct Node *a, struct Node *b) {
+    return intersectionRec(makeTree(a), makeTree(b)).root;
+}
+
+struct Node *setDifference(struct Node *a, struct Node *b) {
+    return differenceRec(makeTree(a), makeTree(b)).root;
+}
+
+// Below this many nodes a union is not worth a thread
+#define PARALLEL_CUTOFF 20000
+
+// Arguments and result of one half of a parallel union
+struct UnionTask {
+    struct Tree a;
+    struct Tree b;
+    struct Tree result;
+    int depth;
+};
+
+struct Tree parallelUnionRec(struct Tree a, struct Tree b, int depth);
+
+void *unionTask(void *arg) {
+    struct UnionTask *task = (struct UnionTask *)arg;
+    task->result = parallelUnionRec(task->a, task->b, task->depth);
+    return NULL;
+}
+
+// Function to merge two trees like unionRec, running the two
+// recursive calls in parallel for depth levels: the left
+// half on a new thread, the right half on this one
+struct Tree parallelUnionRec(struct Tree a, struct Tree b, int depth) {
+    if (depth == 0 || a.root == NULL || b.root == NULL
+        || getSize(a.root) + getSize(b.root) < PARALLEL_CUTOFF)
+        return unionRec(a, b);
+    struct Node *mid = a.root;
+    struct Tree aRight, bRight;
+    struct UnionTask task;
+    task.depth = depth - 1;
+    detachChildren(a, &task.a, &aRight);
+    free(splitTree(b, mid->key, &task.b, &bRight));
+
+    pthread_t thread;
+    bool forked = pthread_create(&thread, NULL, unionTask, &task) == 0;
+    if (!forked)
+        unionTask(&task);
+    struct Tree right = parallelUnionRec(aRight, bRight, depth - 1);
+    if (forked)
+        pthread_join(thread, NULL);
+    return join(task.result, mid, right);
+}
+
+// Function to merge two trees on up to threads threads
+struct Node *setUnionParallel(struct Node *a, struct Node *b,
+    int threads) {
+    int depth = 0;
+    while ((1 << depth) < threads) {
+        depth++;
+    }
+    return parallelUnionRec(makeTree(a), makeTree(b), depth).root;
+}
+
 // Function to perform inOrder (LVR) traversal of AVL tree
 void inOrder(struct Node *root) {
     if (root != NULL) {
@@ -132,6 +699,144 @@ void inOrder(struct Node *root) {
     }
 }
 
+// Benchmark: random inserts, lookups and deletes
+void benchmark(int numKeys) {
+    struct Node *root = NULL;
+    clock_t start = clock();
+    for (int i = 0; i < numKeys; i++) {
+        root = insert(root, (int)((i * 2654435761u) % numKeys));
+    }
+    double insertTime = (double)(clock() - start) / CLOCKS_PER_SEC;
+    int height = getHeight(root);
+
+    long long found = 0;
+    start = clock();
+    for (int i = 0; i < numKeys; i++) {
+        found += search(root, (int)((i * 40503u) % (2u * numKeys)));
+    }
+    double searchTime = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    // k-th smallest and rank, checked against each other
+    long long ranked = 0;
+    unsigned int size = (unsigned int)getSize(root);
+    start = clock();
+    for (int i = 0; i < numKeys; i++) {
+        struct Node *node = selectKth(root, 1 + (int)((i * 40503u) % size));
+        ranked += rank(root, node->key);
+    }
+    double rankTime = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (int i = 0; i < numKeys; i++) {
+        root = deleteKey(root, (int)((i * 2246822519u) % numKeys));
+    }
+    double deleteTime = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    printf("%d keys, %zu bytes/node, height %d: insert %.2f, "
+           "search %.2f, select+rank %.2f, delete %.2f Mops/s "
+           "(%lld %lld)\n",
+        numKeys, sizeof(struct Node), height,
+        numKeys / insertTime / 1e6, numKeys / searchTime / 1e6,
+        numKeys / rankTime / 1e6, numKeys / deleteTime / 1e6, found,
+        ranked);
+    freeTree(root);
+}
+
+// Function to get wall-clock time in seconds
+double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Function to build a tree of the multiples of step below
+// limit, from sorted keys
+struct Node *buildMultiples(int step, int limit) {
+    int count = (limit + step - 1) / step;
+    int *keys = (int *)malloc(count * sizeof(int));
+    for (int i = 0; i < count; i++) {
+        keys[i] = i * step;
+    }
+    struct Node *root = buildSorted(keys, count);
+    free(keys);
+    return root;
+}
+
+// Benchmark: bulk build and set operations on sorted
+// snapshots against one insert() per key
+void benchmarkSetOps(int numKeys) {
+    int *keys = (int *)malloc(numKeys * sizeof(int));
+    for (int i = 0; i < numKeys; i++) {
+        keys[i] = i * 2;
+    }
+    double start = now();
+    struct Node *built = buildSorted(keys, numKeys);
+    double buildTime = now() - start;
+    start = now();
+    struct Node *inserted = NULL;
+    for (int i = 0; i < numKeys; i++) {
+        inserted = insert(inserted, keys[i]);
+    }
+    double insertTime = now() - start;
+    printf("build %d sorted keys: buildSorted %.3fs, insert %.3fs\n",
+        numKeys, buildTime, insertTime);
+    freeTree(built);
+    freeTree(inserted);
+    free(keys);
+
+    // Two overlapping snapshots: multiples of 2 and of 3
+    struct Node *a = buildMultiples(2, 2 * numKeys);
+    struct Node *b = buildMultiples(3, 2 * numKeys);
+    start = now();
+    for (int key = 0; key < 2 * numKeys; key += 3) {
+        a = insert(a, key);
+    }
+    double oneByOne = now() - start;
+    freeTree(a);
+    a = buildMultiples(2, 2 * numKeys);
+    start = now();
+    a = setUnion(a, b);
+    printf("union %d + %d keys: setUnion %.3fs, insert %.3fs, "
+           "%d keys\n",
+        numKeys, (2 * numKeys + 2) / 3, now() - start, oneByOne,
+        getSize(a));
+    freeTree(a);
+
+    // A small set into a large one
+    a = buildMultiples(2, 2 * numKeys);
+    b = buildMultiples(2 * numKeys / 1000, 2 * numKeys);
+    start = now();
+    a = setUnion(a, b);
+    printf("union %d + %d keys: setUnion %.6fs\n", numKeys,
+        1000, now() - start);
+    freeTree(a);
+
+    a = buildMultiples(2, 2 * numKeys);
+    b = buildMultiples(3, 2 * numKeys);
+    start = now();
+    a = setIntersection(a, b);
+    double intersectTime = now() - start;
+    int common = getSize(a);
+    freeTree(a);
+    a = buildMultiples(2, 2 * numKeys);
+    b = buildMultiples(3, 2 * numKeys);
+    start = now();
+    a = setDifference(a, b);
+    printf("intersection %.3fs (%d keys), difference %.3fs (%d keys)\n",
+        intersectTime, common, now() - start, getSize(a));
+    freeTree(a);
+
+    for (int threads = 1; threads <= 8; threads *= 2) {
+        a = buildMultiples(2, 2 * numKeys);
+        b = buildMultiples(3, 2 * numKeys);
+        start = now();
+        a = setUnionParallel(a, b, threads);
+        printf("setUnionParallel %d threads: %.3fs\n", threads,
+            now() - start);
+        freeTree(a);
+    }
+}
+
 // Main function
 int main() {
     struct Node *root = NULL;
@@ -147,6 +852,53 @@ int main() {
     // Print preorder traversal of the AVL tree
     printf("Inorder traversal of AVL tree: ");
     inOrder(root);
+    printf("\n");
+
+    // Deleting nodes
+    root = deleteKey(root, 4);
+    root = deleteKey(root, 1);
+    printf("Inorder traversal after deleting 4 and 1: ");
+    inOrder(root);
+    printf("\n");
+
+    // Order statistics
+    printf("2nd smallest: %d, rank of 5: %d, keys in [3, 6]: %d\n",
+        selectKth(root, 2)->key, rank(root, 5), countRange(root, 3, 6));
+
+    // Set operations, the operands are used up
+    int evens[] = {0, 2, 4, 6, 8, 10};
+    int threes[] = {0, 3, 6, 9};
+    struct Node *a = buildSorted(evens, 6);
+    struct Node *b = buildSorted(threes, 4);
+    struct Node *u = setUnion(a, b);
+    printf("Union of {0 2 4 6 8 10} and {0 3 6 9}: ");
+    inOrder(u);
+    struct Node *below, *above;
+    split(u, 5, &below, &above);
+    printf("\nSplit at 5: ");
+    inOrder(below);
+    printf("| ");
+    inOrder(above);
+    printf("\nIntersection and difference: ");
+    struct Node *i = setIntersection(buildSorted(evens, 6),
+        buildSorted(threes, 4));
+    struct Node *d = setDifference(buildSorted(evens, 6),
+        buildSorted(threes, 4));
+    inOrder(i);
+    printf("| ");
+    inOrder(d);
+    printf("\n\n");
+    freeTree(below);
+    freeTree(above);
+    freeTree(i);
+    freeTree(d);
+    freeTree(root);
+
+    benchmark(1000000);
+    benchmark(4000000);
+    printf("\n");
+
+    benchmarkSetOps(4000000);
 
     return 0;
 }
\ No newline at end of file
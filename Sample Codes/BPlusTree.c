@@ -1,25 +1,64 @@
 // C Program to Implement B+ Tree
+#include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 #define MIN_DEGREE                                         \
     3 // Minimum degree (defines the range for number of
       // keys)
 
+// Size of a cache line, every node is a multiple of it
+#define CACHE_LINE 64
+
+// Key array capacity is rounded up to this many keys so the
+// SIMD rank search can always load a full vector
+#define KEY_BLOCK 16
+
+// A pending insert or delete of a key in buffered mode
+typedef struct Message {
+    int key;
+    bool isDelete;
+} Message;
+
+// Messages waiting in an internal node, oldest first. Every
+// message belongs to the child its key routes to. The same
+// allocation holds, after msgs, a hash index of 2 * capacity
+// slots, each 0 or one past the newest message for a key.
+// Lookups bring the index up to date, so appends stay cheap
+typedef struct MessageBuffer {
+    int count;
+    int capacity;
+    // Number of messages the index covers
+    int indexed;
+    Message msgs[];
+} MessageBuffer;
+
+// A node is one allocation: this header, then the keys,
+// then the child pointers. The header is 48 bytes so the
+// first keys share its cache line
 typedef struct Node {
-    // Array of keys
-    int *keys;
-    // Minimum degree (defines the range for number of keys)
-    int t;
-    // Array of child pointers
-    struct Node **children;
     // Current number of keys
     int n;
+    // Minimum degree (defines the range for number of keys)
+    int t;
     // To determine whether the node is leaf or not
     bool leaf;
+    // Array of keys, points just past the header
+    int *keys;
+    // Array of child pointers, points just past the keys
+    struct Node **children;
     // Pointer to next leaf node
     struct Node *next;
+    // Pending messages of an internal node in buffered mode,
+    // NULL until the first one arrives
+    MessageBuffer *buffer;
 } Node;
 
 typedef struct BTree {
@@ -27,74 +66,362 @@ typedef struct BTree {
     Node *root;
     // Minimum degree
     int t;
+    // Whether inserts and deletes go through the message
+    // buffers of the internal nodes (Be-tree style)
+    bool buffered;
+    // Number of messages a node holds before it is flushed
+    int bufferSize;
 } BTree;
 
+// Function to get the size in bytes of a node of degree t
+size_t nodeSize(int t) {
+    size_t keyCapacity
+        = (2 * t - 1 + KEY_BLOCK - 1) / KEY_BLOCK * KEY_BLOCK;
+    size_t size = sizeof(Node) + keyCapacity * sizeof(int);
+    size = (size + sizeof(Node *) - 1) / sizeof(Node *)
+        * sizeof(Node *);
+    size += 2 * t * sizeof(Node *);
+    return (size + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+}
+
 // Function to create a new B+ tree node
 Node *createNode(int t, bool leaf) {
-    Node *newNode = (Node *)malloc(sizeof(Node));
+    Node *newNode = (Node *)aligned_alloc(CACHE_LINE, nodeSize(t));
+    size_t keyCapacity
+        = (2 * t - 1 + KEY_BLOCK - 1) / KEY_BLOCK * KEY_BLOCK;
+    size_t childOffset = sizeof(Node) + keyCapacity * sizeof(int);
+    childOffset = (childOffset + sizeof(Node *) - 1)
+        / sizeof(Node *) * sizeof(Node *);
     newNode->t = t;
     newNode->leaf = leaf;
-    newNode->keys = (int *)malloc((2 * t - 1) * sizeof(int));
-    newNode->children
-        = (Node **)malloc((2 * t) * sizeof(Node *));
+    newNode->keys = (int *)(newNode + 1);
+    newNode->children = (Node **)((char *)newNode + childOffset);
     newNode->n = 0;
     newNode->next = NULL;
+    newNode->buffer = NULL;
     return newNode;
 }
 
+// Function to free a single node
+void freeNode(Node *node) {
+    free(node->buffer);
+    free(node);
+}
+
+// Function to free a subtree
+void freeTree(Node *node) {
+    if (!node->leaf) {
+        for (int i = 0; i <= node->n; i++) {
+            freeTree(node->children[i]);
+        }
+    }
+    freeNode(node);
+}
+
 // Function to create a new B+ tree
 BTree *createBTree(int t) {
     BTree *btree = (BTree *)malloc(sizeof(BTree));
     btree->t = t;
     btree->root = createNode(t, true);
+    btree->buffered = false;
+    btree->bufferSize = 0;
     return btree;
 }
 
-// Function to display the B+ tree and print its keys
+// Function to create a B+ tree in buffered mode: inserts
+// and deletes are queued as messages in the root and pushed
+// down a level at a time, bufferSize messages per node
+BTree *createBufferedBTree(int t, int bufferSize) {
+    BTree *btree = createBTree(t);
+    btree->buffered = true;
+    btree->bufferSize = bufferSize;
+    return btree;
+}
+
+// Function to count the keys of a node that are smaller
+// than key (orEqual: smaller or equal). Keys are compared
+// a vector at a time: 16 with AVX-512, 8 with AVX2, 4 with
+// SSE2. Lanes past n are masked off, the key array is
+// padded to KEY_BLOCK so the loads stay inside the node
+int rankSearch(Node *node, int key, bool orEqual) {
+    int n = node->n;
+    const int *keys = node->keys;
+    int rank = 0;
+#if defined(__AVX512F__)
+    __m512i needle = _mm512_set1_epi32(key);
+    for (int i = 0; i < n; i += 16) {
+        __m512i block = _mm512_loadu_si512(keys + i);
+        __mmask16 mask = orEqual
+            ? _mm512_cmple_epi32_mask(block, needle)
+            : _mm512_cmplt_epi32_mask(block, needle);
+        if (n - i < 16)
+            mask &= (1u << (n - i)) - 1;
+        rank += __builtin_popcount(mask);
+        if (mask != 0xFFFF)
+            break;
+    }
+#elif defined(__AVX2__)
+    __m256i needle = _mm256_set1_epi32(key);
+    for (int i = 0; i < n; i += 8) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(keys + i));
+        __m256i gt = orEqual ? _mm256_cmpgt_epi32(block, needle)
+                             : _mm256_cmpgt_epi32(needle, block);
+        unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(gt));
+        if (orEqual)
+            mask = ~mask & 0xFF;
+        if (n - i < 8)
+            mask &= (1u << (n - i)) - 1;
+        rank += __builtin_popcount(mask);
+        if (mask != 0xFF)
+            break;
+    }
+#elif defined(__SSE2__)
+    __m128i needle = _mm_set1_epi32(key);
+    for (int i = 0; i < n; i += 4) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(keys + i));
+        __m128i gt = orEqual ? _mm_cmpgt_epi32(block, needle)
+                             : _mm_cmpgt_epi32(needle, block);
+        unsigned mask = _mm_movemask_ps(_mm_castsi128_ps(gt));
+        if (orEqual)
+            mask = ~mask & 0xF;
+        if (n - i < 4)
+            mask &= (1u << (n - i)) - 1;
+        rank += __builtin_popcount(mask);
+        if (mask != 0xF)
+            break;
+    }
+#else
+    while (rank < n
+        && (orEqual ? keys[rank] <= key : keys[rank] < key)) {
+        rank++;
+    }
+#endif
+    return rank;
+}
+
+// Function to find the index of a key in a node
+int findKey(Node *node, int key) { return rankSearch(node, key, false); }
+
+// Function to find the child to descend into for a key,
+// keys equal to a separator live in the right subtree
+int findChild(Node *node, int key) { return rankSearch(node, key, true); }
+
+// Function to get the number of messages buffered in a node
+int messageCount(Node *node) {
+    return node->buffer == NULL ? 0 : node->buffer->count;
+}
+
+// Function to get the index slot holding a key, or the
+// empty slot where it would go. The index is at most half
+// full, so probing always ends
+int *findSlot(MessageBuffer *buffer, int key) {
+    int *slots = (int *)&buffer->msgs[buffer->capacity];
+    unsigned int mask = 2 * buffer->capacity - 1;
+    unsigned int h = (unsigned int)key * 2654435761u;
+    for (unsigned int i = (h ^ (h >> 16)) & mask;; i = (i + 1) & mask) {
+        if (slots[i] == 0 || buffer->msgs[slots[i] - 1].key == key)
+            return &slots[i];
+    }
+}
+
+// Function to empty the index of a buffer after its
+// messages were moved or replaced
+void resetIndex(MessageBuffer *buffer) {
+    if (buffer->indexed > 0)
+        memset(&buffer->msgs[buffer->capacity], 0,
+            2 * buffer->capacity * sizeof(int));
+    buffer->indexed = 0;
+}
+
+// Function to append a message to a buffer, the buffer is
+// created on first use and doubles when it runs out of room
+void appendMessage(MessageBuffer **buffer, Message msg) {
+    MessageBuffer *old = *buffer;
+    if (old == NULL || old->count == old->capacity) {
+        int capacity = old == NULL ? 16 : 2 * old->capacity;
+        MessageBuffer *grown = (MessageBuffer *)realloc(old,
+            sizeof(MessageBuffer) + capacity * sizeof(Message)
+            + 2 * capacity * sizeof(int));
+        if (old == NULL)
+            grown->count = 0;
+        grown->capacity = capacity;
+        grown->indexed = 0;
+        memset(&grown->msgs[capacity], 0, 2 * capacity * sizeof(int));
+        *buffer = grown;
+    }
+    (*buffer)->msgs[(*buffer)->count++] = msg;
+}
+
+// Function to find the newest message for a key in a node's
+// buffer, NULL if there is none
+Message *findMessage(Node *node, int key) {
+    MessageBuffer *buffer = node->buffer;
+    if (buffer == NULL || buffer->count == 0)
+        return NULL;
+    for (; buffer->indexed < buffer->count; buffer->indexed++) {
+        Message *msg = &buffer->msgs[buffer->indexed];
+        *findSlot(buffer, msg->key) = buffer->indexed + 1;
+    }
+    int slot = *findSlot(buffer, key);
+    return slot == 0 ? NULL : &buffer->msgs[slot - 1];
+}
+
+// Function to move the messages with key >= bound (above) or
+// key < bound (!above) from one node's buffer to another's.
+// Used when keys change hands between sibling nodes; a key
+// is only ever buffered in one of them, so order is kept
+void moveMessages(Node *from, Node *to, int bound, bool above) {
+    int kept = 0;
+    for (int i = 0; i < messageCount(from); i++) {
+        Message msg = from->buffer->msgs[i];
+        if ((msg.key >= bound) == above) {
+            appendMessage(&to->buffer, msg);
+        } else {
+            from->buffer->msgs[kept++] = msg;
+        }
+    }
+    if (from->buffer != NULL) {
+        from->buffer->count = kept;
+        resetIndex(from->buffer);
+    }
+}
+
+// Function to find the leftmost leaf
+Node *firstLeaf(Node *node) {
+    while (!node->leaf) {
+        node = node->children[0];
+    }
+    return node;
+}
+
+// Function to display the B+ tree and print its keys,
+// all keys are in the leaves so the leaf chain is walked
 void display(Node *node) {
     if (node == NULL)
         return;
-    int i;
-    for (i = 0; i < node->n; i++) {
-        if (!node->leaf) {
-            display(node->children[i]);
+    for (Node *leaf = firstLeaf(node); leaf != NULL;
+         leaf = leaf->next) {
+        for (int i = 0; i < leaf->n; i++) {
+            printf("%d ", leaf->keys[i]);
         }
-        printf("%d ", node->keys[i]);
-    }
-    if (!node->leaf) {
-        display(node->children[i]);
     }
 }
 
-// Function to search a key in the B+ tree
+// Function to search a key in the B+ tree. In buffered
+// mode a pending message on the way down is newer than
+// anything below it and decides the answer
 bool search(Node *node, int key) {
-    int i = 0;
-    while (i < node->n && key > node->keys[i]) {
-        i++;
+    while (!node->leaf) {
+        Message *msg = findMessage(node, key);
+        if (msg != NULL)
+            return !msg->isDelete;
+        node = node->children[findChild(node, key)];
     }
-    if (i < node->n && key == node->keys[i]) {
-        return true;
+    int i = findKey(node, key);
+    return i < node->n && node->keys[i] == key;
+}
+
+// Cursor over the leaf chain, positioned on one key
+typedef struct Cursor {
+    // Current leaf, NULL once the cursor is past the end
+    Node *leaf;
+    // Index of the current key in the leaf
+    int pos;
+} Cursor;
+
+void flushBuffers(BTree *btree);
+
+// Function to position a cursor on the first key >= key.
+// Pending messages are flushed first so the leaves are
+// current
+Cursor seek(BTree *btree, int key) {
+    if (btree->buffered)
+        flushBuffers(btree);
+    Node *node = btree->root;
+    while (!node->leaf) {
+        node = node->children[findChild(node, key)];
     }
-    if (node->leaf) {
-        return false;
+    Cursor cursor = {node, findKey(node, key)};
+    while (cursor.leaf != NULL && cursor.pos >= cursor.leaf->n) {
+        cursor.leaf = cursor.leaf->next;
+        cursor.pos = 0;
     }
-    return search(node->children[i], key);
+    return cursor;
+}
+
+bool cursorValid(Cursor *cursor) { return cursor->leaf != NULL; }
+
+int cursorKey(Cursor *cursor) {
+    return cursor->leaf->keys[cursor->pos];
 }
 
-// Function to split the child of a node during insertion
+// Function to move a cursor to the next key
+void cursorNext(Cursor *cursor) {
+    cursor->pos++;
+    while (cursor->leaf != NULL && cursor->pos >= cursor->leaf->n) {
+        cursor->leaf = cursor->leaf->next;
+        cursor->pos = 0;
+    }
+}
+
+// Function to call callback for every key in [lo, hi] in
+// ascending order, stops early if callback returns false.
+// Returns the number of keys visited
+int rangeScan(BTree *btree, int lo, int hi,
+    bool (*callback)(int key, void *arg), void *arg) {
+    int count = 0;
+    if (lo > hi)
+        return 0;
+    Cursor cursor = seek(btree, lo);
+    while (cursor.leaf != NULL) {
+        Node *leaf = cursor.leaf;
+
+        // Scan the rest of this leaf without re-checking
+        // the cursor on every key
+        for (int i = cursor.pos; i < leaf->n; i++) {
+            if (leaf->keys[i] > hi)
+                return count;
+            count++;
+            if (!callback(leaf->keys[i], arg))
+                return count;
+        }
+        cursor.leaf = leaf->next;
+        cursor.pos = 0;
+    }
+    return count;
+}
+
+// Function to split the child of a node during insertion.
+// A leaf keeps its first t - 1 keys, the new leaf gets the
+// other t and a copy of its first key goes up as separator.
+// An internal node moves its middle key up as before
 void splitChild(Node *parent, int i, Node *child) {
     int t = child->t;
     Node *newChild = createNode(t, child->leaf);
-    newChild->n = t - 1;
+    int separator;
 
-    for (int j = 0; j < t - 1; j++) {
-        newChild->keys[j] = child->keys[j + t];
-    }
+    if (child->leaf) {
+        newChild->n = t;
+        for (int j = 0; j < t; j++) {
+            newChild->keys[j] = child->keys[j + t - 1];
+        }
+        separator = newChild->keys[0];
 
-    if (!child->leaf) {
+        // Link the new leaf into the leaf chain
+        newChild->next = child->next;
+        child->next = newChild;
+    } else {
+        newChild->n = t - 1;
+        for (int j = 0; j < t - 1; j++) {
+            newChild->keys[j] = child->keys[j + t];
+        }
         for (int j = 0; j < t; j++) {
             newChild->children[j] = child->children[j + t];
         }
+        separator = child->keys[t - 1];
+
+        // Messages for the moved children move with them
+        moveMessages(child, newChild, separator, true);
     }
 
     child->n = t - 1;
@@ -107,7 +434,7 @@ void splitChild(Node *parent, int i, Node *child) {
     for (int j = parent->n - 1; j >= i; j--) {
         parent->keys[j + 1] = parent->keys[j];
     }
-    parent->keys[i] = child->keys[t - 1];
+    parent->keys[i] = separator;
     parent->n += 1;
 }
 
@@ -116,6 +443,11 @@ void insertNonFull(Node *node, int key) {
     int i = node->n - 1;
 
     if (node->leaf) {
+        // Keys are unique, ignore a key that is already there
+        int idx = findKey(node, key);
+        if (idx < node->n && node->keys[idx] == key) {
+            return;
+        }
         while (i >= 0 && node->keys[i] > key) {
             node->keys[i + 1] = node->keys[i];
             i--;
@@ -123,13 +455,10 @@ void insertNonFull(Node *node, int key) {
         node->keys[i + 1] = key;
         node->n += 1;
     } else {
-        while (i >= 0 && node->keys[i] > key) {
-            i--;
-        }
-        i++;
+        i = findChild(node, key);
         if (node->children[i]->n == 2 * node->t - 1) {
             splitChild(node, i, node->children[i]);
-            if (node->keys[i] < key) {
+            if (node->keys[i] <= key) {
                 i++;
             }
         }
@@ -137,9 +466,15 @@ void insertNonFull(Node *node, int key) {
     }
 }
 
+void bufferMessage(BTree *btree, int key, bool isDelete);
+
 // Function to insert a key into the B+ tree
 void insert(BTree *btree, int key) {
     Node *root = btree->root;
+    if (btree->buffered && !root->leaf) {
+        bufferMessage(btree, key, false);
+        return;
+    }
     if (root->n == 2 * btree->t - 1) {
         Node *newRoot = createNode(btree->t, false);
         newRoot->children[0] = root;
@@ -151,12 +486,99 @@ void insert(BTree *btree, int key) {
     }
 }
 
+// Function to pick how many items go into the next node of
+// a level being bulk loaded: per items normally, everything
+// that is left for the last node, and an even split of the
+// last two nodes when per would leave fewer than min behind
+int nextGroupSize(int remaining, int per, int min, int max) {
+    if (remaining <= max)
+        return remaining;
+    if (remaining - per < min)
+        return remaining / 2;
+    return per;
+}
+
+// Function to build a B+ tree bottom-up from count sorted
+// keys (duplicates are skipped). Leaves are packed to
+// fillFactor of their capacity (clamped to the legal range),
+// then each internal level is built from the one below in a
+// single pass, so every node is written exactly once
+BTree *bulkLoad(const int *keys, int count, int t, double fillFactor) {
+    BTree *btree = createBTree(t);
+    if (count == 0)
+        return btree;
+    freeNode(btree->root);
+
+    int perLeaf = (int)(fillFactor * (2 * t - 1) + 0.5);
+    int perNode = (int)(fillFactor * (2 * t) + 0.5);
+    perLeaf = perLeaf < t - 1 ? t - 1 : perLeaf > 2 * t - 1 ? 2 * t - 1 : perLeaf;
+    perNode = perNode < t ? t : perNode > 2 * t ? 2 * t : perNode;
+    if (perLeaf < 1)
+        perLeaf = 1;
+
+    // Drop duplicates first so group sizes are exact
+    int *unique = (int *)malloc(count * sizeof(int));
+    int numUnique = 0;
+    for (int i = 0; i < count; i++) {
+        if (numUnique == 0 || keys[i] != unique[numUnique - 1])
+            unique[numUnique++] = keys[i];
+    }
+
+    // Nodes of the level being built and the smallest key
+    // under each, which becomes its separator in the parent
+    int numLeaves = numUnique / perLeaf + 1;
+    Node **level = (Node **)malloc(numLeaves * sizeof(Node *));
+    int *minKey = (int *)malloc(numLeaves * sizeof(int));
+    int levelSize = 0;
+
+    Node *prev = NULL;
+    for (int i = 0; i < numUnique;) {
+        int size = nextGroupSize(numUnique - i, perLeaf, t - 1, 2 * t - 1);
+        Node *leaf = createNode(t, true);
+        for (int j = 0; j < size; j++) {
+            leaf->keys[j] = unique[i + j];
+        }
+        leaf->n = size;
+        if (prev != NULL)
+            prev->next = leaf;
+        prev = leaf;
+        minKey[levelSize] = unique[i];
+        level[levelSize++] = leaf;
+        i += size;
+    }
+    free(unique);
+
+    // Each pass turns one level into its parent level, in
+    // place since a parent never outruns its children
+    while (levelSize > 1) {
+        int parents = 0;
+        for (int i = 0; i < levelSize;) {
+            int size = nextGroupSize(levelSize - i, perNode, t, 2 * t);
+            Node *node = createNode(t, false);
+            for (int j = 0; j < size; j++) {
+                node->children[j] = level[i + j];
+                if (j > 0)
+                    node->keys[j - 1] = minKey[i + j];
+            }
+            node->n = size - 1;
+            minKey[parents] = minKey[i];
+            level[parents++] = node;
+            i += size;
+        }
+        levelSize = parents;
+    }
+
+    btree->root = level[0];
+    free(level);
+    free(minKey);
+    return btree;
+}
+
 // Function prototypes for helper functions used in
 // deleteKey
 void deleteKeyHelper(Node *node, int key);
 int findKey(Node *node, int key);
 void removeFromLeaf(Node *node, int idx);
-int getPredecessor(Node *node, int idx);
 void fill(Node *node, int idx);
 void borrowFromPrev(Node *node, int idx);
 void borrowFromNext(Node *node, int idx);
@@ -165,6 +587,10 @@ void merge(Node *node, int idx);
 // Function for deleting a key from the B+ tree
 void deleteKey(BTree *btree, int key) {
     Node *root = btree->root;
+    if (btree->buffered && !root->leaf) {
+        bufferMessage(btree, key, true);
+        return;
+    }
 
     // Call a helper function to delete the key recursively
     deleteKeyHelper(root, key);
@@ -173,67 +599,48 @@ void deleteKey(BTree *btree, int key) {
     // first child the new root
     if (root->n == 0 && !root->leaf) {
         btree->root = root->children[0];
-        free(root);
+        freeNode(root);
     }
 }
 
 // Helper function to recursively delete a key from the B+
-// tree
+// tree. Keys only live in the leaves, separators in
+// internal nodes are left as they are: a separator equal to
+// a deleted key still routes every remaining key correctly
 void deleteKeyHelper(Node *node, int key) {
-    int idx = findKey(
-        node, key); // Find the index of the key in the node
-
-    // If key is present in this node
-    if (idx < node->n && node->keys[idx] == key) {
-        if (node->leaf) {
+    if (node->leaf) {
+        int idx = findKey(node, key);
+        if (idx < node->n && node->keys[idx] == key) {
             // If the node is a leaf, simply remove the key
             removeFromLeaf(node, idx);
         } else {
-            // If the node is not a leaf, replace the key
-            // with its predecessor/successor
-            int predecessor = getPredecessor(node, idx);
-            node->keys[idx] = predecessor;
-            // Recursively delete the predecessor
-            deleteKeyHelper(node->children[idx],
-                predecessor);
-        }
-    } else {
-        // If the key is not present in this node, go down
-        // the appropriate child
-        if (node->leaf) {
             // Key not found in the tree
             printf("Key %d not found in the B+ tree.\n",
                 key);
-            return;
         }
+        return;
+    }
 
-        bool isLastChild = (idx == node->n);
+    // Go down the child the key belongs to
+    int idx = findChild(node, key);
+    bool isLastChild = (idx == node->n);
 
-        // If the child where the key is supposed to be lies
-        // has less than t keys, fill that child
-        if (node->children[idx]->n < node->t) {
-            fill(node, idx);
-        }
+    // If the child where the key is supposed to be lies
+    // has less than t keys, fill that child
+    if (node->children[idx]->n < node->t) {
+        fill(node, idx);
+    }
 
-        // If the last child has been merged, it must have
-        // merged with the previous child
+    // If the last child has been merged, it must have
+    // merged with the previous child
 
-        // So, we need to recursively delete the key from
-        // the previous child
-        if (isLastChild && idx > node->n) {
-            deleteKeyHelper(node->children[idx - 1], key);
-        } else {
-            deleteKeyHelper(node->children[idx], key);
-        }
-    }
-}
-// Function to find the index of a key in a node
-int findKey(Node *node, int key) {
-    int idx = 0;
-    while (idx < node->n && key > node->keys[idx]) {
-        idx++;
+    // So, we need to recursively delete the key from
+    // the previous child
+    if (isLastChild && idx > node->n) {
+        deleteKeyHelper(node->children[idx - 1], key);
+    } else {
+        deleteKeyHelper(node->children[idx], key);
     }
-    return idx;
 }
 
 // Function to remove a key from a leaf node
@@ -244,16 +651,6 @@ void removeFromLeaf(Node *node, int idx) {
     node->n--;
 }
 
-// Function to get the predecessor of a key in a non-leaf
-// node
-int getPredecessor(Node *node, int idx) {
-    Node *curr = node->children[idx];
-    while (!curr->leaf) {
-        curr = curr->children[curr->n];
-    }
-    return curr->keys[curr->n - 1];
-}
-
 // Function to fill up the child node present at the idx-th
 // position in the node node
 void fill(Node *node, int idx) {
@@ -277,6 +674,19 @@ void borrowFromPrev(Node *node, int idx) {
     Node *child = node->children[idx];
     Node *sibling = node->children[idx - 1];
 
+    // Leaves move the key itself, the separator becomes a
+    // copy of child's new first key
+    if (child->leaf) {
+        for (int i = child->n - 1; i >= 0; --i) {
+            child->keys[i + 1] = child->keys[i];
+        }
+        child->keys[0] = sibling->keys[sibling->n - 1];
+        node->keys[idx - 1] = child->keys[0];
+        child->n += 1;
+        sibling->n -= 1;
+        return;
+    }
+
     // Move all keys in child one step ahead
     for (int i = child->n - 1; i >= 0; --i) {
         child->keys[i + 1] = child->keys[i];
@@ -301,6 +711,7 @@ void borrowFromPrev(Node *node, int idx) {
 
     // Moving the key from the sibling to the parent
     node->keys[idx - 1] = sibling->keys[sibling->n - 1];
+    moveMessages(sibling, child, node->keys[idx - 1], true);
 
     // Incrementing and decrementing the key counts of child
     // and sibling respectively
@@ -314,6 +725,19 @@ void borrowFromNext(Node *node, int idx) {
     Node *child = node->children[idx];
     Node *sibling = node->children[idx + 1];
 
+    // Leaves move the key itself, the separator becomes a
+    // copy of sibling's new first key
+    if (child->leaf) {
+        child->keys[child->n] = sibling->keys[0];
+        for (int i = 1; i < sibling->n; ++i) {
+            sibling->keys[i - 1] = sibling->keys[i];
+        }
+        child->n += 1;
+        sibling->n -= 1;
+        node->keys[idx] = sibling->keys[0];
+        return;
+    }
+
     // Setting child's (t - 1)th key equal to node's
     // key[idx]
     child->keys[(child->n)] = node->keys[idx];
@@ -328,6 +752,7 @@ void borrowFromNext(Node *node, int idx) {
     // Setting node's idx-th key equal to sibling's first
     // key
     node->keys[idx] = sibling->keys[0];
+    moveMessages(sibling, child, node->keys[idx], false);
 
     // Moving all keys in sibling one step behind
     for (int i = 1; i < sibling->n; ++i) {
@@ -354,6 +779,25 @@ void merge(Node *node, int idx) {
     Node *child = node->children[idx];
     Node *sibling = node->children[idx + 1];
 
+    // Leaves are concatenated, the separator is dropped and
+    // the merged leaf takes over sibling's place in the chain
+    if (child->leaf) {
+        for (int i = 0; i < sibling->n; ++i) {
+            child->keys[child->n + i] = sibling->keys[i];
+        }
+        child->n += sibling->n;
+        child->next = sibling->next;
+        for (int i = idx + 1; i < node->n; ++i) {
+            node->keys[i - 1] = node->keys[i];
+        }
+        for (int i = idx + 2; i <= node->n; ++i) {
+            node->children[i - 1] = node->children[i];
+        }
+        node->n--;
+        freeNode(sibling);
+        return;
+    }
+
     // Pulling a key from the current node and inserting it
     // into (t-1)th position of child
     child->keys[child->n] = node->keys[idx];
@@ -396,8 +840,452 @@ void merge(Node *node, int idx) {
     child->n += sibling->n + 1;
     node->n--;
 
+    // Sibling's pending messages now belong to child
+    moveMessages(sibling, child, INT_MIN, true);
+
     // Free the memory occupied by sibling
-    free(sibling);
+    freeNode(sibling);
+}
+
+// Function to find a child of node with fewer than t - 1
+// keys, -1 if there is none
+int shortChild(Node *node) {
+    if (node->leaf) {
+        return -1;
+    }
+    for (int i = 0; i <= node->n; i++) {
+        if (node->children[i]->n < node->t - 1) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Function to top up the idx-th child of node after
+// messages were flushed into it. Unlike deleteKey, which
+// fills a child before it can underflow, a flushed batch
+// may leave the child several keys short, or with no keys
+// and one short child of its own. That grandchild is topped
+// up once the child has keys again, after a merge with a
+// sibling. If node runs out of keys itself, its caller
+// merges it, or the root collapse removes it
+void refill(Node *node, int idx) {
+    while (true) {
+        Node *child = node->children[idx];
+        int grandchild = child->n > 0 ? shortChild(child) : -1;
+        if (grandchild >= 0) {
+            refill(child, grandchild);
+            continue;
+        }
+        if (child->n >= node->t - 1 || node->n == 0) {
+            return;
+        }
+
+        int before = node->n;
+        fill(node, idx);
+
+        // The last child is merged into the one before it
+        if (node->n < before && idx > node->n) {
+            idx = node->n;
+        }
+    }
+}
+
+// Function to push all messages of a node one level down.
+// node is internal and not full. The messages are grouped
+// by child with a counting sort (oldest first within a
+// group) and the groups are handled right to left, so a
+// child split or merged on the way only shifts children
+// that are done. Each message is routed again as it is
+// handled since borrowing moves separators. An internal
+// child gets the messages added to its own buffer and is
+// flushed in turn once it holds bufferSize of them; a full
+// one is split first. A leaf child has them applied,
+// splitting leaves as it goes. Whatever would need a split
+// while node itself is full stays in node
+void flushMessages(BTree *btree, Node *node) {
+    int t = node->t;
+    int total = node->buffer->count;
+    int groups = node->n + 1;
+    int *route = (int *)malloc(total * sizeof(int));
+    int *bounds = (int *)calloc(groups + 1, sizeof(int));
+    int *pos = (int *)malloc(groups * sizeof(int));
+    Message *batch = (Message *)malloc(total * sizeof(Message));
+
+    for (int i = 0; i < total; i++) {
+        route[i] = findChild(node, node->buffer->msgs[i].key);
+        bounds[route[i] + 1]++;
+    }
+    for (int c = 0; c < groups; c++) {
+        bounds[c + 1] += bounds[c];
+        pos[c] = bounds[c];
+    }
+    for (int i = 0; i < total; i++) {
+        batch[pos[route[i]]++] = node->buffer->msgs[i];
+    }
+    node->buffer->count = 0;
+    resetIndex(node->buffer);
+
+    for (int c = groups - 1; c >= 0; c--) {
+        int first = bounds[c], last = bounds[c + 1];
+        if (first == last)
+            continue;
+        Node *child = node->children[c];
+
+        if (!child->leaf) {
+            if (child->n == 2 * t - 1) {
+                if (node->n == 2 * t - 1) {
+                    for (int i = first; i < last; i++) {
+                        appendMessage(&node->buffer, batch[i]);
+                    }
+                    continue;
+                }
+                splitChild(node, c, child);
+            }
+            for (int i = first; i < last; i++) {
+                Node *target = node->children[findChild(node, batch[i].key)];
+                appendMessage(&target->buffer, batch[i]);
+            }
+
+            // Flush whichever buffers have filled up: the
+            // child and, after a split, its new right half. A
+            // flushed child may need refilling, which takes a
+            // key of node to merge or borrow with
+            for (int d = c + 1; d >= c; d--) {
+                if (d > node->n || node->n == 0)
+                    continue;
+                Node *target = node->children[d];
+                if (target->n < 2 * t - 1
+                    && messageCount(target) >= btree->bufferSize) {
+                    flushMessages(btree, target);
+                    refill(node, d);
+                }
+            }
+            continue;
+        }
+
+        for (int i = first; i < last; i++) {
+            int key = batch[i].key;
+            int idx = findChild(node, key);
+            Node *leaf = node->children[idx];
+            int at = findKey(leaf, key);
+            bool present = at < leaf->n && leaf->keys[at] == key;
+
+            if (batch[i].isDelete) {
+                if (present) {
+                    removeFromLeaf(leaf, at);
+                    refill(node, idx);
+                }
+            } else if (!present) {
+                if (leaf->n == 2 * t - 1) {
+                    if (node->n == 2 * t - 1) {
+                        for (; i < last; i++) {
+                            appendMessage(&node->buffer, batch[i]);
+                        }
+                        break;
+                    }
+                    splitChild(node, idx, leaf);
+                    if (node->keys[idx] <= key) {
+                        leaf = node->children[idx + 1];
+                    }
+                }
+                insertNonFull(leaf, key);
+            }
+        }
+    }
+    free(route);
+    free(bounds);
+    free(pos);
+    free(batch);
+}
+
+// Function to queue an insert or delete at the root in
+// buffered mode, flushing the root once its buffer is full.
+// A full root is split instead, which hands its messages to
+// the two halves
+void bufferMessage(BTree *btree, int key, bool isDelete) {
+    Node *root = btree->root;
+    Message msg = {key, isDelete};
+    appendMessage(&root->buffer, msg);
+    if (messageCount(root) < btree->bufferSize)
+        return;
+
+    if (root->n == 2 * btree->t - 1) {
+        Node *newRoot = createNode(btree->t, false);
+        newRoot->children[0] = root;
+        splitChild(newRoot, 0, root);
+        btree->root = newRoot;
+        return;
+    }
+    flushMessages(btree, root);
+
+    // Merges below can leave the root without keys, its only
+    // child takes over together with the root's messages
+    while (!root->leaf && root->n == 0) {
+        Node *child = root->children[0];
+        btree->root = child;
+        if (!child->leaf) {
+            moveMessages(root, child, INT_MIN, true);
+            freeNode(root);
+            root = child;
+            continue;
+        }
+
+        // A leaf root takes no messages, replay them
+        MessageBuffer *pending = root->buffer;
+        root->buffer = NULL;
+        freeNode(root);
+        for (int i = 0; pending != NULL && i < pending->count; i++) {
+            int k = pending->msgs[i].key;
+            if (!pending->msgs[i].isDelete) {
+                insert(btree, k);
+            } else if (search(btree->root, k)) {
+                deleteKey(btree, k);
+            }
+        }
+        free(pending);
+        break;
+    }
+}
+
+// Function to collect the messages of a subtree, children
+// before their parent. A key's messages all lie on one path
+// and deeper ones are older, so this is the order to apply
+// them in
+void collectMessages(Node *node, MessageBuffer **all) {
+    if (node->leaf)
+        return;
+    for (int i = 0; i <= node->n; i++) {
+        collectMessages(node->children[i], all);
+    }
+    if (node->buffer == NULL)
+        return;
+
+    for (int i = 0; i < node->buffer->count; i++) {
+        appendMessage(all, node->buffer->msgs[i]);
+    }
+    free(node->buffer);
+    node->buffer = NULL;
+}
+
+// Function to apply every pending message to the leaves,
+// after which the tree is an ordinary B+ tree again. Scans
+// and cursors call this before reading the leaf chain
+void flushBuffers(BTree *btree) {
+    MessageBuffer *all = NULL;
+    collectMessages(btree->root, &all);
+    if (all == NULL)
+        return;
+
+    btree->buffered = false;
+    for (int i = 0; i < all->count; i++) {
+        int key = all->msgs[i].key;
+        if (!all->msgs[i].isDelete) {
+            insert(btree, key);
+        } else if (search(btree->root, key)) {
+            deleteKey(btree, key);
+        }
+    }
+    btree->buffered = true;
+    free(all);
+}
+
+// Callback for rangeScan that prints each key
+bool printKey(int key, void *arg) {
+    (void)arg;
+    printf("%d ", key);
+    return true;
+}
+
+// Callback for rangeScan that adds up the keys
+bool sumKey(int key, void *arg) {
+    *(long long *)arg += key;
+    return true;
+}
+
+double seconds(clock_t start) {
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+// Benchmark: scanning a range through the leaf chain
+// against one search() per key of the range
+void benchmarkRangeScan(int t, int numKeys, int rangeLen) {
+    BTree *btree = createBTree(t);
+
+    // Only even keys, odd keys in a range are misses
+    for (int i = 0; i < numKeys; i++) {
+        insert(btree, (int)((i * 2654435761u) % numKeys) * 2);
+    }
+
+    int queries = 1000;
+    long long sum = 0, found = 0;
+    clock_t start = clock();
+    for (int q = 0; q < queries; q++) {
+        int lo = (int)((q * 40503u) % numKeys) * 2;
+        rangeScan(btree, lo, lo + rangeLen, sumKey, &sum);
+    }
+    double scanTime = seconds(start);
+
+    start = clock();
+    for (int q = 0; q < queries; q++) {
+        int lo = (int)((q * 40503u) % numKeys) * 2;
+        for (int key = lo; key <= lo + rangeLen; key++) {
+            found += search(btree->root, key);
+        }
+    }
+    double searchTime = seconds(start);
+
+    double keys = (double)queries * (rangeLen + 1);
+    printf("range %6d: rangeScan %8.1f Mkeys/s, "
+           "search %6.1f Mkeys/s (%lld %lld)\n",
+        rangeLen, keys / scanTime / 1e6, keys / searchTime / 1e6,
+        sum, found);
+    freeTree(btree->root);
+    free(btree);
+}
+
+// Benchmark: random point lookups for one fanout
+void benchmarkPointLookup(int t, int numKeys) {
+    BTree *btree = createBTree(t);
+    for (int i = 0; i < numKeys; i++) {
+        insert(btree, (int)((i * 2654435761u) % numKeys));
+    }
+
+    int lookups = 2000000;
+    long long found = 0;
+    unsigned int x = 2463534242u;
+    clock_t start = clock();
+    for (int i = 0; i < lookups; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        found += search(btree->root, (int)(x % (2u * numKeys)));
+    }
+    double time = seconds(start);
+    printf("fanout %4d (%5zu bytes/node): %6.2f Mlookups/s (%lld)\n",
+        2 * t, nodeSize(t), lookups / time / 1e6, found);
+    freeTree(btree->root);
+    free(btree);
+}
+
+// Benchmark: building from sorted keys with bulkLoad()
+// against one insert() per key
+void benchmarkBulkLoad(int t, int numKeys) {
+    int *keys = (int *)calloc(numKeys, sizeof(int));
+    for (int i = 0; i < numKeys; i++) {
+        keys[i] = i * 2;
+    }
+
+    clock_t start = clock();
+    BTree *loaded = bulkLoad(keys, numKeys, t, 0.9);
+    double loadTime = seconds(start);
+
+    start = clock();
+    BTree *inserted = createBTree(t);
+    for (int i = 0; i < numKeys; i++) {
+        insert(inserted, keys[i]);
+    }
+    double insertTime = seconds(start);
+
+    long long found = 0;
+    for (int i = 0; i < numKeys; i += 997) {
+        found += search(loaded->root, keys[i]);
+        found -= search(loaded->root, keys[i] + 1);
+    }
+    printf("%d keys, fanout %d: bulkLoad %.3fs, insert %.3fs "
+           "(%.1fx), %lld found\n",
+        numKeys, 2 * t, loadTime, insertTime, insertTime / loadTime,
+        found);
+    freeTree(loaded->root);
+    free(loaded);
+    freeTree(inserted->root);
+    free(inserted);
+    free(keys);
+}
+
+// Benchmark: random inserts in buffered mode against plain
+// insert(), and what the buffers cost a lookup
+void benchmarkBuffered(int t, int numKeys, int bufferSize) {
+    BTree *trees[2] = {createBTree(t), createBufferedBTree(t, bufferSize)};
+    double insertTime[2], lookupTime[2];
+    long long found[2] = {0, 0};
+    for (int m = 0; m < 2; m++) {
+        clock_t start = clock();
+        for (int i = 0; i < numKeys; i++) {
+            insert(trees[m], (int)((i * 2654435761u) % numKeys) * 2);
+        }
+        insertTime[m] = seconds(start);
+
+        // Lookups before the final flush, half of them miss
+        int lookups = 1000000;
+        unsigned int x = 2463534242u;
+        start = clock();
+        for (int i = 0; i < lookups; i++) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            found[m] += search(trees[m]->root, (int)(x % (2u * numKeys)));
+        }
+        lookupTime[m] = seconds(start) / lookups * 1e9;
+    }
+    clock_t start = clock();
+    flushBuffers(trees[1]);
+    double flushTime = seconds(start);
+
+    printf("buffer %5d: insert %.3fs, buffered %.3fs + flush %.3fs "
+           "(%.2fx); lookup %.0f ns vs %.0f ns (%lld %lld)\n",
+        bufferSize, insertTime[0], insertTime[1], flushTime,
+        insertTime[0] / (insertTime[1] + flushTime), lookupTime[0],
+        lookupTime[1], found[0], found[1]);
+    for (int m = 0; m < 2; m++) {
+        freeTree(trees[m]->root);
+        free(trees[m]);
+    }
+}
+
+// Function to check that every node but the root holds at
+// least t - 1 keys, the occupancy deleteKeyHelper relies on
+bool occupancyHolds(Node *node, bool isRoot) {
+    if (!isRoot && node->n < node->t - 1) {
+        return false;
+    }
+    if (node->leaf) {
+        return true;
+    }
+    for (int i = 0; i <= node->n; i++) {
+        if (!occupancyHolds(node->children[i], false)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Function to test that flushed batches of deletes never
+// leave a short or empty leaf behind. With t = 2 and small
+// buffers a batch often empties every leaf of a node
+bool testBufferedOccupancy() {
+    BTree *btree = createBufferedBTree(2, 4);
+    int numKeys = 2000;
+    bool ok = true;
+    for (int i = 0; i < numKeys; i++) {
+        insert(btree, i * 7919 % numKeys);
+        ok = ok && occupancyHolds(btree->root, true);
+    }
+    for (int i = 0; i < numKeys; i++) {
+        int key = i * 503 % numKeys;
+        if (key % 16 != 0) {
+            deleteKey(btree, key);
+            ok = ok && occupancyHolds(btree->root, true);
+        }
+    }
+    for (int key = 0; key < numKeys; key++) {
+        ok = ok && search(btree->root, key) == (key % 16 == 0);
+    }
+    flushBuffers(btree);
+    ok = ok && occupancyHolds(btree->root, true);
+    freeTree(btree->root);
+    free(btree);
+    return ok;
 }
 
 int main() {
@@ -447,5 +1335,40 @@ int main() {
             key_to_search);
     }
 
+    // Keys in [5, 25] through the leaf chain
+    printf("Keys in [5, 25]: ");
+    rangeScan(btree, 5, 25, printKey, NULL);
+    printf("\n");
+
+    // Same range with a cursor
+    printf("Cursor from 5: ");
+    for (Cursor c = seek(btree, 5); cursorValid(&c) && cursorKey(&c) <= 25;
+         cursorNext(&c)) {
+        printf("%d ", cursorKey(&c));
+    }
+    printf("\n\n");
+    freeTree(btree->root);
+    free(btree);
+
+    printf("Buffered deletes keep leaves filled: %s\n\n",
+        testBufferedOccupancy() ? "passed" : "FAILED");
+
+    for (int rangeLen = 10; rangeLen <= 100000; rangeLen *= 10) {
+        benchmarkRangeScan(32, 1000000, rangeLen);
+    }
+    printf("\n");
+
+    for (int t = 4; t <= 256; t *= 2) {
+        benchmarkPointLookup(t, 4000000);
+    }
+    printf("\n");
+
+    benchmarkBulkLoad(32, 10000000);
+    printf("\n");
+
+    for (int bufferSize = 64; bufferSize <= 4096; bufferSize *= 4) {
+        benchmarkBuffered(32, 4000000, bufferSize);
+    }
+
     return 0;
 }
@@ -0,0 +1,14 @@
+// Thread counts the scaling benchmarks step through
+#ifndef BENCH_THREADS_H
+#define BENCH_THREADS_H
+
+// Function to get the thread count to run after threads:
+// powers of two up to maxThreads, then maxThreads itself if
+// it is not one. Returns 0 once maxThreads has run
+static inline int nextThreadCount(int threads, int maxThreads) {
+    if (threads >= maxThreads)
+        return 0;
+    return threads * 2 > maxThreads ? maxThreads : threads * 2;
+}
+
+#endif
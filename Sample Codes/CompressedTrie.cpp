@@ -1,170 +1,1483 @@
 #include <iostream>
+#include <algorithm>
 #include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <chrono>
+#include <random>
+#include <string>
+#include <string_view>
 #include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
 using namespace std;
 
-// Node class
-class Node {
-    static const int SYMBOLS = 26;
-public:
-    vector<Node *> children;
-    vector<string> edgeLabel;
+// Node kinds, named after the most
+// children each of them can hold
+enum NodeType : uint8_t { NODE4, NODE16, NODE48, NODE256 };
+
+// Header shared by every node kind. The
+// label of the edge leading into the node
+// is a slice (labelOffset, labelLength)
+// of the trie's string arena. score is the
+// score of the word ending here, maxScore
+// the highest score in the whole subtree
+struct Node {
+    NodeType type;
     bool isEnd;
+    uint16_t count;
+    uint32_t labelOffset;
+    uint32_t labelLength;
+    uint32_t score;
+    uint32_t maxScore;
+
+    Node(NodeType type)
+        : type(type), isEnd(false), count(0), labelOffset(0), labelLength(0),
+          score(0), maxScore(0) {}
+};
+
+// Up to 4 children, keys kept sorted
+struct Node4 : Node {
+    uint8_t keys[4];
+    Node *children[4];
+
+    Node4() : Node(NODE4) {}
+};
+
+// Up to 16 children, keys kept sorted
+// and compared 16 at a time with SSE2
+struct Node16 : Node {
+    uint8_t keys[16];
+    Node *children[16];
+
+    Node16() : Node(NODE16) {}
+};
 
-    Node(bool isEnd) : isEnd(isEnd) {
-        children.resize(SYMBOLS, nullptr);
-        edgeLabel.resize(SYMBOLS);
+// Up to 48 children. childIndex maps a
+// byte to its slot in children plus one,
+// 0 meaning there is no such child
+struct Node48 : Node {
+    uint8_t childIndex[256];
+    Node *children[48];
+
+    Node48() : Node(NODE48) {
+        memset(childIndex, 0, sizeof(childIndex));
+    }
+};
+
+// One child pointer per byte value
+struct Node256 : Node {
+    Node *children[256];
+
+    Node256() : Node(NODE256) {
+        memset(children, 0, sizeof(children));
     }
 };
 
+// One result of Trie::complete(): the word
+// is text[offset, offset + length) of the
+// caller's text buffer
+struct Completion {
+    uint32_t score;
+    uint32_t offset;
+    uint32_t length;
+};
+
+class LoudsTrie;
+
 // Trie class
 class Trie {
 private:
+    friend class LoudsTrie;
+
+    // A subtree or a single word waiting
+    // in the best-first search of complete(),
+    // linked to the entry it was expanded from
+    struct SearchEntry {
+        Node *node;
+        int parent;
+        uint32_t priority;
+        bool isWord;
+    };
+
     Node *root;
-    char CASE;
+    string arena;
+    size_t deadBytes;
+
+    // Scratch space of complete(), kept so
+    // that repeated queries do not allocate
+    vector<SearchEntry> entries;
+    vector<int> frontier;
+
+    // Function to free the subtree
+    // rooted at the given node
+    void freeNode(Node *node) {
+        forEachChild(node, [this](uint8_t, Node *child) { freeNode(child); });
+        freeSingle(node);
+    }
+
+    // Function to call fn(key, child) for
+    // every child of the node in key order
+    template <typename Fn>
+    static void forEachChild(Node *node, Fn fn) {
+        switch (node->type) {
+        case NODE4: {
+            Node4 *n = static_cast<Node4 *>(node);
+            for (int i = 0; i < n->count; i++)
+                fn(n->keys[i], n->children[i]);
+            break;
+        }
+        case NODE16: {
+            Node16 *n = static_cast<Node16 *>(node);
+            for (int i = 0; i < n->count; i++)
+                fn(n->keys[i], n->children[i]);
+            break;
+        }
+        case NODE48: {
+            Node48 *n = static_cast<Node48 *>(node);
+            for (int b = 0; b < 256; b++)
+                if (n->childIndex[b])
+                    fn((uint8_t)b, n->children[n->childIndex[b] - 1]);
+            break;
+        }
+        case NODE256: {
+            Node256 *n = static_cast<Node256 *>(node);
+            for (int b = 0; b < 256; b++)
+                if (n->children[b])
+                    fn((uint8_t)b, n->children[b]);
+            break;
+        }
+        }
+    }
+
+    // Function to find the slot holding
+    // the child for the given key byte,
+    // or NULL if there is no such child
+    static Node **findChild(Node *node, uint8_t key) {
+        switch (node->type) {
+        case NODE4: {
+            Node4 *n = static_cast<Node4 *>(node);
+            for (int i = 0; i < n->count; i++)
+                if (n->keys[i] == key)
+                    return &n->children[i];
+            return NULL;
+        }
+        case NODE16: {
+            Node16 *n = static_cast<Node16 *>(node);
+#ifdef __SSE2__
+            __m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8((char)key),
+                                         _mm_loadu_si128((__m128i *)n->keys));
+            int mask = _mm_movemask_epi8(cmp) & ((1 << n->count) - 1);
+            return mask ? &n->children[__builtin_ctz(mask)] : NULL;
+#else
+            for (int i = 0; i < n->count; i++)
+                if (n->keys[i] == key)
+                    return &n->children[i];
+            return NULL;
+#endif
+        }
+        case NODE48: {
+            Node48 *n = static_cast<Node48 *>(node);
+            return n->childIndex[key] ? &n->children[n->childIndex[key] - 1] : NULL;
+        }
+        case NODE256: {
+            Node256 *n = static_cast<Node256 *>(node);
+            return n->children[key] ? &n->children[key] : NULL;
+        }
+        }
+        return NULL;
+    }
+
+    // Function to insert a child into the
+    // sorted key array of a Node4 or Node16
+    static void insertSorted(uint8_t *keys, Node **children, int count,
+                             uint8_t key, Node *child) {
+        int pos = count;
+        while (pos > 0 && keys[pos - 1] > key) {
+            keys[pos] = keys[pos - 1];
+            children[pos] = children[pos - 1];
+            pos--;
+        }
+        keys[pos] = key;
+        children[pos] = child;
+    }
+
+    // Function that creates a node of another
+    // kind carrying over the header of the
+    // given one
+    template <typename T>
+    static T *resizedFrom(Node *node) {
+        T *resized = new T();
+        resized->isEnd = node->isEnd;
+        resized->count = node->count;
+        resized->labelOffset = node->labelOffset;
+        resized->labelLength = node->labelLength;
+        resized->score = node->score;
+        resized->maxScore = node->maxScore;
+        return resized;
+    }
+
+    // Function to replace the full node
+    // at *ref with the next larger kind
+    static void grow(Node **ref) {
+        Node *node = *ref;
+        switch (node->type) {
+        case NODE4: {
+            Node4 *n = static_cast<Node4 *>(node);
+            Node16 *bigger = resizedFrom<Node16>(n);
+            memcpy(bigger->keys, n->keys, sizeof(n->keys));
+            memcpy(bigger->children, n->children, sizeof(n->children));
+            *ref = bigger;
+            delete n;
+            break;
+        }
+        case NODE16: {
+            Node16 *n = static_cast<Node16 *>(node);
+            Node48 *bigger = resizedFrom<Node48>(n);
+            for (int i = 0; i < n->count; i++) {
+                bigger->childIndex[n->keys[i]] = i + 1;
+                bigger->children[i] = n->children[i];
+            }
+            *ref = bigger;
+            delete n;
+            break;
+        }
+        case NODE48: {
+            Node48 *n = static_cast<Node48 *>(node);
+            Node256 *bigger = resizedFrom<Node256>(n);
+            for (int b = 0; b < 256; b++)
+                if (n->childIndex[b])
+                    bigger->children[b] = n->children[n->childIndex[b] - 1];
+            *ref = bigger;
+            delete n;
+            break;
+        }
+        case NODE256:
+            break;
+        }
+    }
+
+    // Function to replace the node at *ref,
+    // which has become sparse, with the next
+    // smaller kind. The thresholds leave some
+    // slack so that a node at the boundary
+    // does not flip between kinds
+    static void shrink(Node **ref) {
+        Node *node = *ref;
+        int k = 0;
+        switch (node->type) {
+        case NODE4:
+            return;
+        case NODE16: {
+            if (node->count > 3)
+                return;
+            Node4 *smaller = resizedFrom<Node4>(node);
+            forEachChild(node, [&](uint8_t key, Node *child) {
+                smaller->keys[k] = key;
+                smaller->children[k++] = child;
+            });
+            *ref = smaller;
+            delete static_cast<Node16 *>(node);
+            return;
+        }
+        case NODE48: {
+            if (node->count > 12)
+                return;
+            Node16 *smaller = resizedFrom<Node16>(node);
+            forEachChild(node, [&](uint8_t key, Node *child) {
+                smaller->keys[k] = key;
+                smaller->children[k++] = child;
+            });
+            *ref = smaller;
+            delete static_cast<Node48 *>(node);
+            return;
+        }
+        case NODE256: {
+            if (node->count > 40)
+                return;
+            Node48 *smaller = resizedFrom<Node48>(node);
+            forEachChild(node, [&](uint8_t key, Node *child) {
+                smaller->children[k] = child;
+                smaller->childIndex[key] = ++k;
+            });
+            *ref = smaller;
+            delete static_cast<Node256 *>(node);
+            return;
+        }
+        }
+    }
+
+    // Function to remove the child for the
+    // given key byte from the node at *ref,
+    // shrinking the node if it gets sparse
+    static void removeChild(Node **ref, uint8_t key) {
+        Node *node = *ref;
+        switch (node->type) {
+        case NODE4:
+        case NODE16: {
+            uint8_t *keys = node->type == NODE4 ? static_cast<Node4 *>(node)->keys
+                                                : static_cast<Node16 *>(node)->keys;
+            Node **children = node->type == NODE4 ? static_cast<Node4 *>(node)->children
+                                                  : static_cast<Node16 *>(node)->children;
+            int pos = 0;
+            while (keys[pos] != key)
+                pos++;
+            for (int i = pos + 1; i < node->count; i++) {
+                keys[i - 1] = keys[i];
+                children[i - 1] = children[i];
+            }
+            break;
+        }
+        case NODE48: {
+            // Keep children dense by moving the
+            // last one into the freed slot
+            Node48 *n = static_cast<Node48 *>(node);
+            int slot = n->childIndex[key] - 1;
+            int last = n->count - 1;
+            n->childIndex[key] = 0;
+            if (slot != last) {
+                n->children[slot] = n->children[last];
+                for (int b = 0; b < 256; b++) {
+                    if (n->childIndex[b] == last + 1) {
+                        n->childIndex[b] = slot + 1;
+                        break;
+                    }
+                }
+            }
+            break;
+        }
+        case NODE256:
+            static_cast<Node256 *>(node)->children[key] = NULL;
+            break;
+        }
+        node->count--;
+        shrink(ref);
+    }
+
+    // Function to add a child under the
+    // node at *ref, growing it if full
+    static void addChild(Node **ref, uint8_t key, Node *child) {
+        Node *node = *ref;
+        switch (node->type) {
+        case NODE4:
+            if (node->count == 4)
+                break;
+            insertSorted(static_cast<Node4 *>(node)->keys,
+                         static_cast<Node4 *>(node)->children, node->count, key, child);
+            node->count++;
+            return;
+        case NODE16:
+            if (node->count == 16)
+                break;
+            insertSorted(static_cast<Node16 *>(node)->keys,
+                         static_cast<Node16 *>(node)->children, node->count, key, child);
+            node->count++;
+            return;
+        case NODE48: {
+            Node48 *n = static_cast<Node48 *>(node);
+            if (n->count == 48)
+                break;
+            n->children[n->count] = child;
+            n->childIndex[key] = ++n->count;
+            return;
+        }
+        case NODE256:
+            static_cast<Node256 *>(node)->children[key] = child;
+            node->count++;
+            return;
+        }
+        grow(ref);
+        addChild(ref, key, child);
+    }
+
+    // Function that creates a leaf whose
+    // label is copied into the arena
+    Node *newLeaf(string_view word, size_t from, uint32_t score) {
+        Node4 *leaf = new Node4();
+        leaf->isEnd = true;
+        leaf->score = score;
+        leaf->maxScore = score;
+        leaf->labelOffset = arena.size();
+        leaf->labelLength = word.length() - from;
+        arena.append(word.data() + from, word.length() - from);
+        return leaf;
+    }
+
+    // Function to find the length of the
+    // common prefix of a and b, comparing
+    // 8 bytes at a time
+    static size_t commonPrefix(const char *a, const char *b, size_t n) {
+        size_t i = 0;
+        while (i + 8 <= n) {
+            uint64_t x, y;
+            memcpy(&x, a + i, 8);
+            memcpy(&y, b + i, 8);
+            if (x != y) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+                return i + __builtin_ctzll(x ^ y) / 8;
+#else
+                return i + __builtin_clzll(x ^ y) / 8;
+#endif
+            }
+            i += 8;
+        }
+        while (i < n && a[i] == b[i])
+            i++;
+        return i;
+    }
+
+    // Function to free a single node
+    // without touching its children
+    static void freeSingle(Node *node) {
+        switch (node->type) {
+        case NODE4: delete static_cast<Node4 *>(node); break;
+        case NODE16: delete static_cast<Node16 *>(node); break;
+        case NODE48: delete static_cast<Node48 *>(node); break;
+        case NODE256: delete static_cast<Node256 *>(node); break;
+        }
+    }
+
+    // Function to merge the node at *ref into
+    // its only child, concatenating their labels.
+    // Labels split from one edge are still
+    // adjacent in the arena and are simply
+    // joined; otherwise the concatenation is
+    // appended and both old slices become dead
+    void mergeWithChild(Node **ref) {
+        Node *node = *ref;
+        Node *child = NULL;
+        forEachChild(node, [&](uint8_t, Node *only) { child = only; });
+
+        if (node->labelOffset + node->labelLength == child->labelOffset) {
+            child->labelOffset = node->labelOffset;
+        } else {
+            size_t offset = arena.size();
+            arena.reserve(offset + node->labelLength + child->labelLength);
+            arena.append(arena.data() + node->labelOffset, node->labelLength);
+            arena.append(arena.data() + child->labelOffset, child->labelLength);
+            deadBytes += node->labelLength + child->labelLength;
+            child->labelOffset = offset;
+        }
+        child->labelLength += node->labelLength;
+        *ref = child;
+        freeSingle(node);
+    }
+
+    // Function to recompute the highest score
+    // in the subtree from the node's own word
+    // and the cached maxima of its children
+    static uint32_t subtreeMax(Node *node) {
+        uint32_t best = node->isEnd ? node->score : 0;
+        forEachChild(node, [&](uint8_t, Node *child) {
+            best = max(best, child->maxScore);
+        });
+        return best;
+    }
+
+    // Function to recompute maxScore on the
+    // path of a word present in the trie,
+    // bottom up, after its score was lowered
+    void refreshPath(Node *node, string_view word, size_t i) {
+        if (i < word.length()) {
+            Node *child = *findChild(node, (uint8_t)word[i]);
+            refreshPath(child, word, i + child->labelLength);
+        }
+        node->maxScore = subtreeMax(node);
+    }
+
+    // Function to remove the word from the
+    // subtree at *ref, where i is the position
+    // in the word just past the node's label.
+    // On the way back up, emptied children are
+    // unlinked and chains of single children
+    // are merged so the trie stays compressed.
+    // maxScore only needs recomputing where
+    // the removed score was the maximum, and
+    // once it comes out unchanged no ancestor
+    // can change either, so removed is reset
+    bool eraseUtil(Node **ref, string_view word, size_t i, uint32_t &removed) {
+        Node *node = *ref;
+        if (i == word.length()) {
+            if (!node->isEnd) {
+                return false;
+            }
+            node->isEnd = false;
+            removed = node->score;
+            node->score = 0;
+        } else {
+            uint8_t key = (uint8_t)word[i];
+            Node **slot = findChild(node, key);
+            if (slot == NULL) {
+                return false;
+            }
+
+            Node *child = *slot;
+            if (word.length() - i < child->labelLength ||
+                memcmp(word.data() + i, arena.data() + child->labelOffset,
+                       child->labelLength) != 0) {
+                return false;
+            }
+            if (!eraseUtil(slot, word, i + child->labelLength, removed)) {
+                return false;
+            }
 
-    // Function that creates new string
-    // from an existing string starting
-    // from the given index
-    string strCopy(string str, int index) {
-        string result;
-        for (int i = index; i < str.length(); ++i) {
-            result += str[i];
+            child = *slot;
+            if (child->count == 0 && !child->isEnd) {
+                deadBytes += child->labelLength;
+                freeSingle(child);
+                removeChild(ref, key);
+                node = *ref;
+            }
         }
-        return result;
+
+        if (removed != 0 && removed == node->maxScore) {
+            node->maxScore = subtreeMax(node);
+            if (node->maxScore == removed) {
+                removed = 0;
+            }
+        }
+        if (ref != &root && node->count == 1 && !node->isEnd) {
+            mergeWithChild(ref);
+        }
+        return true;
+    }
+
+    // Function to copy every live label
+    // into a fresh arena, dropping the
+    // bytes of deleted and merged edges
+    void compactArena() {
+        string compacted;
+        compacted.reserve(arena.size() - deadBytes);
+        compactUtil(root, compacted);
+        arena.swap(compacted);
+        deadBytes = 0;
+    }
+
+    // Function to copy the labels below
+    // the given node into compacted
+    void compactUtil(Node *node, string &compacted) {
+        forEachChild(node, [&](uint8_t, Node *child) {
+            size_t offset = compacted.size();
+            compacted.append(arena.data() + child->labelOffset, child->labelLength);
+            child->labelOffset = offset;
+            compactUtil(child, compacted);
+        });
     }
 
     // Function to print the word
     // starting from the given node
-    void printUtil(Node *node, string str) {
+    void printUtil(Node *node, string &str) {
         if (node->isEnd) {
             cout << str << endl;
         }
 
-        for (int i = 0; i < node->edgeLabel.size(); ++i) {
-            if (!node->edgeLabel[i].empty()) {
-                string temp = str + node->edgeLabel[i];
-                printUtil(node->children[i], temp);
-            }
-        }
+        forEachChild(node, [&](uint8_t, Node *child) {
+            size_t length = str.length();
+            str.append(arena, child->labelOffset, child->labelLength);
+            printUtil(child, str);
+            str.resize(length);
+        });
+    }
+
+    // Function to accumulate node counts
+    // and bytes used per node kind
+    void statsUtil(Node *node, size_t counts[4], size_t &bytes) {
+        static const size_t sizes[4] = {sizeof(Node4), sizeof(Node16),
+                                        sizeof(Node48), sizeof(Node256)};
+        counts[node->type]++;
+        bytes += sizes[node->type];
+        forEachChild(node, [&](uint8_t, Node *child) {
+            statsUtil(child, counts, bytes);
+        });
     }
 
 public:
-    Trie(char CASE = 'a') : CASE(CASE) {
-        root = new Node(false);
+    Trie() : deadBytes(0) {
+        root = new Node4();
     }
 
-    // Function to insert a word in
-    // the compressed trie
-    void insert(string word) {
-        Node *trav = root;
-        int i = 0;
+    ~Trie() {
+        freeNode(root);
+    }
+
+    Trie(const Trie &) = delete;
+    Trie &operator=(const Trie &) = delete;
+
+    // Function to insert a word in the
+    // compressed trie, or to update its
+    // score if it is already present
+    void insert(string_view word, uint32_t score = 0) {
+        Node **ref = &root;
+        size_t i = 0;
 
-        while (i < word.length() && !trav->edgeLabel[word[i] - CASE].empty()) {
-            int index = word[i] - CASE;
-            int j = 0;
-            string label = trav->edgeLabel[index];
+        while (i < word.length()) {
+            (*ref)->maxScore = max((*ref)->maxScore, score);
+            Node **slot = findChild(*ref, (uint8_t)word[i]);
+            if (slot == NULL) {
+                addChild(ref, (uint8_t)word[i], newLeaf(word, i, score));
+                return;
+            }
+
+            Node *child = *slot;
+            uint32_t j = commonPrefix(arena.data() + child->labelOffset, word.data() + i,
+                                      min<size_t>(child->labelLength, word.length() - i));
+            i += j;
 
-            while (j < label.length() && i < word.length() && label[j] == word[i]) {
-                ++i;
-                ++j;
+            if (j == child->labelLength) {
+                ref = slot;
+                continue;
             }
 
-            if (j == label.length()) {
-                trav = trav->children[index];
+            // Split the edge: the new node takes the matched
+            // part of the label and the old child keeps the rest,
+            // both as slices of the same arena bytes
+            Node4 *middle = new Node4();
+            middle->labelOffset = child->labelOffset;
+            middle->labelLength = j;
+            child->labelOffset += j;
+            child->labelLength -= j;
+            middle->keys[0] = (uint8_t)arena[child->labelOffset];
+            middle->children[0] = child;
+            middle->count = 1;
+            middle->maxScore = max(child->maxScore, score);
+            *slot = middle;
+
+            if (i == word.length()) {
+                middle->isEnd = true;
+                middle->score = score;
             } else {
-                if (i == word.length()) {
-                    Node *existingChild = trav->children[index];
-                    Node *newChild = new Node(true);
-                    string remainingLabel = label.substr(j);
-                    trav->children[index] = newChild;
-                    newChild->children[remainingLabel[0] - CASE] = existingChild;
-                    newChild->edgeLabel[remainingLabel[0] - CASE] = remainingLabel;
-                } else {
-                    string remainingLabel = label.substr(j);
-                    Node *newChild = new Node(false);
-                    string remainingWord = word.substr(i);
-                    Node *temp = trav->children[index];
-                    trav->children[index] = newChild;
-                    newChild->edgeLabel[remainingLabel[0] - CASE] = remainingLabel;
-                    newChild->children[remainingLabel[0] - CASE] = temp;
-                    newChild->edgeLabel[remainingWord[0] - CASE] = remainingWord;
-                    newChild->children[remainingWord[0] - CASE] = new Node(true);
-                }
-                return;
+                Node *leaf = newLeaf(word, i, score);
+                insertSorted(middle->keys, middle->children, 1, (uint8_t)word[i], leaf);
+                middle->count = 2;
             }
+            return;
         }
 
-        if (i < word.length()) {
-            trav->edgeLabel[word[i] - CASE] = strCopy(word, i);
-            trav->children[word[i] - CASE] = new Node(true);
-        } else {
-            trav->isEnd = true;
+        Node *node = *ref;
+        bool lowered = node->isEnd && score < node->score;
+        node->isEnd = true;
+        node->score = score;
+        node->maxScore = max(node->maxScore, score);
+        if (lowered) {
+            refreshPath(root, word, 0);
         }
     }
 
+    // Function to delete a word, returning
+    // false if it was not in the trie. The
+    // arena is compacted once more than
+    // half of it is dead
+    bool erase(string_view word) {
+        uint32_t removed;
+        if (!eraseUtil(&root, word, 0, removed)) {
+            return false;
+        }
+        if (deadBytes > 4096 && deadBytes > arena.size() / 2) {
+            compactArena();
+        }
+        return true;
+    }
+
     // Function to print the Trie
     void print() {
-        printUtil(root, "");
+        string str;
+        printUtil(root, str);
     }
 
-    // Function to search a word
-    bool search(string word) {
-        int i = 0;
+    // Function to search a word. Labels are
+    // compared in place in the arena, so
+    // nothing is allocated or copied
+    bool search(string_view word) {
+        size_t i = 0;
         Node *trav = root;
 
-        while (i < word.length() && !trav->edgeLabel[word[i] - CASE].empty()) {
-            int index = word[i] - CASE;
-            string label = trav->edgeLabel[index];
-            int j = 0;
-
-            while (i < word.length() && j < label.length()) {
-                if (word[i] != label[j]) {
-                    return false;
-                }
-                i++;
-                j++;
+        while (i < word.length()) {
+            Node **slot = findChild(trav, (uint8_t)word[i]);
+            if (slot == NULL) {
+                return false;
             }
 
-            if (j == label.length() && i <= word.length()) {
-                trav = trav->children[index];
-            } else {
+            trav = *slot;
+            if (word.length() - i < trav->labelLength ||
+                memcmp(word.data() + i, arena.data() + trav->labelOffset,
+                       trav->labelLength) != 0) {
                 return false;
             }
+            i += trav->labelLength;
         }
 
-        return i == word.length() && trav->isEnd;
+        return trav->isEnd;
     }
 
     // Function to search the prefix
-    bool startsWith(string prefix) {
-        int i = 0;
+    bool startsWith(string_view prefix) {
+        size_t i = 0;
+        Node *trav = root;
+
+        while (i < prefix.length()) {
+            Node **slot = findChild(trav, (uint8_t)prefix[i]);
+            if (slot == NULL) {
+                return false;
+            }
+
+            trav = *slot;
+            size_t n = min<size_t>(prefix.length() - i, trav->labelLength);
+            if (memcmp(prefix.data() + i, arena.data() + trav->labelOffset, n) != 0) {
+                return false;
+            }
+            i += n;
+        }
+
+        return true;
+    }
+
+    // Function to find the k highest scoring
+    // words starting with prefix, best first.
+    // The words are written back to back into
+    // text and described by results, which
+    // must have room for k entries. Returns
+    // the number of results written, fewer
+    // than k if the prefix has fewer words or
+    // text runs out of room.
+    //
+    // The search is best first over subtrees
+    // ordered by their cached maxScore, so it
+    // only expands nodes that can still hold
+    // one of the k best words
+    int complete(string_view prefix, int k, Completion *results, char *text,
+                 size_t textSize) {
+        // Find the node whose label covers the
+        // end of the prefix; base is the part of
+        // the prefix before that label
+        size_t i = 0, base = 0;
         Node *trav = root;
+        while (i < prefix.length()) {
+            Node **slot = findChild(trav, (uint8_t)prefix[i]);
+            if (slot == NULL) {
+                return 0;
+            }
+
+            trav = *slot;
+            base = i;
+            size_t n = min<size_t>(prefix.length() - i, trav->labelLength);
+            if (memcmp(prefix.data() + i, arena.data() + trav->labelOffset, n) != 0) {
+                return 0;
+            }
+            i += n;
+        }
 
-        while (i < prefix.length() && !trav->edgeLabel[prefix[i] - CASE].empty()) {
-            int index = prefix[i] - CASE;
-            string label = trav->edgeLabel[index];
-            int j = 0;
+        auto lower = [this](int a, int b) {
+            return entries[a].priority < entries[b].priority;
+        };
+        entries.clear();
+        frontier.clear();
+        entries.push_back({trav, -1, trav->maxScore, false});
+        frontier.push_back(0);
 
-            while (i < prefix.length() && j < label.length()) {
-                if (prefix[i] != label[j]) {
-                    return false;
+        int found = 0;
+        size_t used = 0;
+        while (found < k && !frontier.empty()) {
+            pop_heap(frontier.begin(), frontier.end(), lower);
+            int current = frontier.back();
+            frontier.pop_back();
+            SearchEntry entry = entries[current];
+
+            if (entry.isWord) {
+                // Write the word backwards from the
+                // end of its slot, following the
+                // entries up to the prefix node
+                size_t length = base;
+                for (int e = current; e != -1; e = entries[e].parent)
+                    length += entries[e].isWord ? 0 : entries[e].node->labelLength;
+                if (used + length > textSize) {
+                    break;
+                }
+
+                char *end = text + used + length;
+                for (int e = current; e != -1; e = entries[e].parent) {
+                    if (entries[e].isWord)
+                        continue;
+                    Node *node = entries[e].node;
+                    end -= node->labelLength;
+                    memcpy(end, arena.data() + node->labelOffset, node->labelLength);
                 }
-                i++;
-                j++;
+                memcpy(text + used, prefix.data(), base);
+
+                results[found++] = {entry.priority, (uint32_t)used, (uint32_t)length};
+                used += length;
+                continue;
             }
 
-            if (j == label.length() && i <= prefix.length()) {
-                trav = trav->children[index];
-            } else {
-                return true;
+            if (entry.node->isEnd) {
+                entries.push_back({entry.node, current, entry.node->score, true});
+                frontier.push_back(entries.size() - 1);
+                push_heap(frontier.begin(), frontier.end(), lower);
             }
+            forEachChild(entry.node, [&](uint8_t, Node *child) {
+                entries.push_back({child, current, child->maxScore, false});
+                frontier.push_back(entries.size() - 1);
+                push_heap(frontier.begin(), frontier.end(), lower);
+            });
+        }
+        return found;
+    }
+
+    // Function to print how many nodes of
+    // each kind the trie holds and the
+    // bytes used by nodes and the arena
+    void printStats() {
+        size_t counts[4] = {0, 0, 0, 0};
+        size_t bytes = 0;
+        statsUtil(root, counts, bytes);
+        cout << "Node4: " << counts[NODE4] << ", Node16: " << counts[NODE16]
+             << ", Node48: " << counts[NODE48] << ", Node256: " << counts[NODE256]
+             << endl;
+        cout << "Node bytes: " << bytes << ", arena bytes: " << arena.size()
+             << " (" << deadBytes << " dead)" << endl;
+    }
+};
+
+// Marks a file written by LoudsTrie::save()
+#define LOUDS_MAGIC 0x5344554f4c495254ull
+
+// Bits covered by one entry of a
+// bit vector's rank directory
+#define RANK_BLOCK 512
+
+// Every this many ones (and zeros) the
+// block holding it is recorded as a hint
+// that narrows the search of select
+#define SELECT_SAMPLE 1024
+
+// Read-only view of a bit vector stored as
+// 64-bit words, with the number of ones
+// before each 512-bit block alongside it.
+// Rank takes one directory lookup and at
+// most 8 popcounts. Select binary searches
+// the directory between two hints, the
+// blocks holding the surrounding sampled
+// ones (or zeros), then scans one block
+struct BitVector {
+    const uint64_t *words;
+    const uint32_t *blockRanks;
+    const uint32_t *oneHints;
+    const uint32_t *zeroHints;
+    uint64_t size;
+
+    bool get(uint64_t pos) const {
+        return words[pos / 64] >> (pos % 64) & 1;
+    }
+
+    // Function to count the ones in [0, pos)
+    uint64_t rank1(uint64_t pos) const {
+        uint64_t block = pos / RANK_BLOCK;
+        uint64_t rank = blockRanks[block];
+        for (uint64_t w = block * (RANK_BLOCK / 64); w < pos / 64; w++)
+            rank += __builtin_popcountll(words[w]);
+        if (pos % 64)
+            rank += __builtin_popcountll(words[pos / 64] & ((1ull << (pos % 64)) - 1));
+        return rank;
+    }
+
+    // Function to find the position of the
+    // set bit with rank k within a word
+    static int selectInWord(uint64_t x, uint64_t k) {
+#ifdef __BMI2__
+        return __builtin_ctzll(_pdep_u64(1ull << k, x));
+#else
+        int shift = 0;
+        uint64_t count;
+        while (k >= (count = __builtin_popcountll((x >> shift) & 0xff))) {
+            k -= count;
+            shift += 8;
         }
+        x >>= shift;
+        while (k--)
+            x &= x - 1;
+        return shift + __builtin_ctzll(x);
+#endif
+    }
+
+    // Function to find the position of the
+    // one (or zero) with rank k, counting from 0
+    template <bool ONES>
+    uint64_t select(uint64_t k) const {
+        auto before = [this](uint64_t block) {
+            return ONES ? blockRanks[block] : block * RANK_BLOCK - blockRanks[block];
+        };
+
+        // Last block starting with at most k
+        // matching bits before it
+        const uint32_t *hints = ONES ? oneHints : zeroHints;
+        uint64_t lo = hints[k / SELECT_SAMPLE], hi = hints[k / SELECT_SAMPLE + 1];
+        while (lo < hi) {
+            uint64_t mid = (lo + hi + 1) / 2;
+            if (before(mid) <= k)
+                lo = mid;
+            else
+                hi = mid - 1;
+        }
+
+        k -= before(lo);
+        for (uint64_t w = lo * (RANK_BLOCK / 64);; w++) {
+            uint64_t x = ONES ? words[w] : ~words[w];
+            uint64_t count = __builtin_popcountll(x);
+            if (k < count)
+                return w * 64 + selectInWord(x, k);
+            k -= count;
+        }
+    }
+
+    uint64_t select1(uint64_t k) const { return select<true>(k); }
+    uint64_t select0(uint64_t k) const { return select<false>(k); }
 
-        return i == prefix.length();
+    // Function to find the first position at
+    // or after pos holding the given bit. The
+    // caller guarantees that one exists
+    uint64_t next(uint64_t pos, bool bit) const {
+        uint64_t w = pos / 64;
+        uint64_t x = (bit ? words[w] : ~words[w]) & (~0ull << (pos % 64));
+        while (x == 0) {
+            w++;
+            x = bit ? words[w] : ~words[w];
+        }
+        return w * 64 + __builtin_ctzll(x);
     }
 };
 
+// Bit vector under construction
+struct BitVectorBuilder {
+    vector<uint64_t> words;
+    uint64_t size = 0;
+
+    void push(bool bit) {
+        if (size % 64 == 0)
+            words.push_back(0);
+        words.back() |= (uint64_t)bit << (size % 64);
+        size++;
+    }
+};
+
+// Header at the start of a frozen image.
+// The sections follow in this order, each
+// padded to whole 64-bit words:
+//   louds       bits, rank directory and
+//               select hints
+//   terminal    bits, one per node
+//   tailBounds  bits, rank directory and
+//               select hints
+//   firstBytes  one byte per node
+//   tails       the label bytes after
+//               each node's first one
+struct LoudsHeader {
+    uint64_t magic;
+    uint64_t nodes;
+    uint64_t loudsBits;
+    uint64_t tailBits;
+};
+
+// Immutable level-order unary degree sequence
+// (LOUDS) encoding of a frozen Trie. Nodes are
+// numbered in breadth-first order. The louds
+// bit vector starts with "10" and then holds,
+// for every node, a one per child followed by
+// a zero, so the children of node v are the
+// consecutive ids after the (v+1)-th zero.
+//
+// Each node's label is split into its first
+// byte, kept in a byte array so children can
+// be binary searched, and its tail, packed
+// into one byte array whose boundaries are a
+// one per node followed by a zero per byte in
+// tailBounds. In total 4 bits and 1 byte
+// per node plus 1 bit per tail byte, on top
+// of the tail bytes themselves and about 10%
+// for the rank and select indexes.
+//
+// The whole encoding is one contiguous image,
+// either built in memory by freezing a trie or
+// mapped read-only from a saved file
+class LoudsTrie {
+private:
+    vector<uint64_t> image;
+    void *map;
+    size_t mapSize;
+
+    uint64_t nodes;
+    BitVector louds;
+    BitVector terminal;
+    BitVector tailBounds;
+    const uint8_t *firstBytes;
+    const char *tails;
+
+    // Functions to size the sections
+    // of the image in 64-bit words
+    static uint64_t wordsFor(uint64_t bytes) {
+        return (bytes + 7) / 8;
+    }
+
+    static uint64_t bitWords(uint64_t bits) {
+        return (bits + 63) / 64;
+    }
+
+    static uint64_t rankWords(uint64_t bits) {
+        return wordsFor(((bits + RANK_BLOCK - 1) / RANK_BLOCK + 1) * sizeof(uint32_t));
+    }
+
+    static uint64_t hintWords(uint64_t count) {
+        return wordsFor((count / SELECT_SAMPLE + 2) * sizeof(uint32_t));
+    }
+
+    // Words taken by a bit vector with its
+    // rank directory and select hints
+    static uint64_t indexedWords(uint64_t bits, uint64_t ones) {
+        return bitWords(bits) + rankWords(bits) + hintWords(ones) + hintWords(bits - ones);
+    }
+
+    // Function to point a view at a bit vector
+    // with its rank directory and select hints
+    static BitVector indexedView(const uint64_t *at, uint64_t bits, uint64_t ones) {
+        const uint64_t *ranks = at + bitWords(bits);
+        const uint64_t *oneHints = ranks + rankWords(bits);
+        const uint64_t *zeroHints = oneHints + hintWords(ones);
+        return {at, (const uint32_t *)ranks, (const uint32_t *)oneHints,
+                (const uint32_t *)zeroHints, bits};
+    }
+
+    // Function to append select hints for the
+    // ones (or zeros) of a bit vector whose rank
+    // directory is already in the image
+    void appendHints(size_t ranksAt, uint64_t bits, uint64_t count, bool ones) {
+        uint64_t blocks = (bits + RANK_BLOCK - 1) / RANK_BLOCK;
+        auto before = [&](uint64_t block) {
+            uint32_t rank = ((const uint32_t *)(image.data() + ranksAt))[block];
+            return ones ? rank : block * RANK_BLOCK - rank;
+        };
+
+        size_t start = image.size();
+        image.resize(start + hintWords(count));
+        uint32_t *hints = (uint32_t *)(image.data() + start);
+        uint64_t block = 0;
+        for (uint64_t j = 0; j <= count / SELECT_SAMPLE; j++) {
+            while (block + 1 < blocks && before(block + 1) <= j * SELECT_SAMPLE)
+                block++;
+            hints[j] = block;
+        }
+        hints[count / SELECT_SAMPLE + 1] = blocks - 1;
+    }
+
+    // Function to append a bit vector to the
+    // image, with its rank directory and
+    // select hints if it needs them
+    void appendBits(const BitVectorBuilder &bits, bool indexed) {
+        image.insert(image.end(), bits.words.begin(), bits.words.end());
+        if (!indexed)
+            return;
+
+        size_t ranksAt = image.size();
+        uint64_t blocks = (bits.size + RANK_BLOCK - 1) / RANK_BLOCK;
+        image.resize(ranksAt + rankWords(bits.size));
+        uint32_t *ranks = (uint32_t *)(image.data() + ranksAt);
+        uint32_t rank = 0;
+        for (uint64_t b = 0; b <= blocks; b++) {
+            ranks[b] = rank;
+            for (uint64_t w = b * (RANK_BLOCK / 64);
+                 w < min<uint64_t>((b + 1) * (RANK_BLOCK / 64), bits.words.size()); w++)
+                rank += __builtin_popcountll(bits.words[w]);
+        }
+
+        appendHints(ranksAt, bits.size, rank, true);
+        appendHints(ranksAt, bits.size, bits.size - rank, false);
+    }
+
+    // Function to append raw bytes to the image
+    void appendBytes(const string &bytes) {
+        size_t start = image.size();
+        image.resize(start + wordsFor(bytes.size()));
+        memcpy(image.data() + start, bytes.data(), bytes.size());
+    }
+
+    // Function to point the views at the sections
+    // of an image of the given length in words.
+    // Returns false if the image is not valid
+    bool attach(const uint64_t *base, size_t length) {
+        if (length < wordsFor(sizeof(LoudsHeader)))
+            return false;
+        const LoudsHeader *header = (const LoudsHeader *)base;
+        uint64_t n = header->nodes;
+        if (header->magic != LOUDS_MAGIC || n == 0 || header->loudsBits != 2 * n + 1 ||
+            header->tailBits < n + 1)
+            return false;
+
+        // louds holds a one per node, tailBounds
+        // one per node plus the closing one
+        uint64_t loudsAt = wordsFor(sizeof(LoudsHeader));
+        uint64_t terminalAt = loudsAt + indexedWords(header->loudsBits, n);
+        uint64_t tailBoundsAt = terminalAt + bitWords(n);
+        uint64_t firstBytesAt = tailBoundsAt + indexedWords(header->tailBits, n + 1);
+        uint64_t tailsAt = firstBytesAt + wordsFor(n);
+        if (tailsAt + wordsFor(header->tailBits - n - 1) > length)
+            return false;
+
+        nodes = n;
+        louds = indexedView(base + loudsAt, header->loudsBits, n);
+        terminal = {base + terminalAt, NULL, NULL, NULL, n};
+        tailBounds = indexedView(base + tailBoundsAt, header->tailBits, n + 1);
+        firstBytes = (const uint8_t *)(base + firstBytesAt);
+        tails = (const char *)(base + tailsAt);
+        return true;
+    }
+
+    // Function to follow key from the root.
+    // Returns the id of the node reached, or
+    // -1 if key leaves the trie. With prefix
+    // set the key may end inside a label
+    int64_t descend(string_view key, bool prefix) const {
+        uint64_t node = 0;
+        size_t i = 0;
+
+        while (i < key.length()) {
+            // Child ids are consecutive: the ones of
+            // node's block, minus the node + 1 zeros
+            // before it
+            uint64_t start = louds.select0(node) + 1;
+            uint64_t count = louds.next(start, false) - start;
+            const uint8_t *first = firstBytes + (start - node - 1);
+            const uint8_t *it = lower_bound(first, first + count, (uint8_t)key[i]);
+            if (it == first + count || *it != (uint8_t)key[i]) {
+                return -1;
+            }
+            node = it - firstBytes;
+            i++;
+
+            uint64_t bound = tailBounds.select1(node);
+            uint64_t tailStart = bound - node;
+            uint64_t tailLength = tailBounds.next(bound + 1, true) - bound - 1;
+            if (key.length() - i < tailLength && !prefix) {
+                return -1;
+            }
+            size_t n = min<size_t>(tailLength, key.length() - i);
+            if (memcmp(key.data() + i, tails + tailStart, n) != 0) {
+                return -1;
+            }
+            i += n;
+        }
+        return node;
+    }
+
+public:
+    LoudsTrie() : map(NULL), mapSize(0), nodes(0) {}
+
+    // Function to freeze a trie: number its nodes
+    // breadth first and build the image
+    explicit LoudsTrie(Trie &trie) : map(NULL), mapSize(0) {
+        BitVectorBuilder loudsBits, terminalBits, tailBits;
+        string first, tailBytes;
+        vector<Node *> queue(1, trie.root);
+
+        loudsBits.push(1);
+        loudsBits.push(0);
+        for (size_t head = 0; head < queue.size(); head++) {
+            Node *node = queue[head];
+            Trie::forEachChild(node, [&](uint8_t, Node *child) {
+                loudsBits.push(1);
+                queue.push_back(child);
+            });
+            loudsBits.push(0);
+            terminalBits.push(node->isEnd);
+
+            const char *label = trie.arena.data() + node->labelOffset;
+            first += node->labelLength ? label[0] : '\0';
+            tailBits.push(1);
+            for (uint32_t j = 1; j < node->labelLength; j++)
+                tailBits.push(0);
+            if (node->labelLength > 1)
+                tailBytes.append(label + 1, node->labelLength - 1);
+        }
+        tailBits.push(1);
+
+        LoudsHeader header = {LOUDS_MAGIC, queue.size(), loudsBits.size, tailBits.size};
+        image.resize(wordsFor(sizeof(header)));
+        memcpy(image.data(), &header, sizeof(header));
+        appendBits(loudsBits, true);
+        appendBits(terminalBits, false);
+        appendBits(tailBits, true);
+        appendBytes(first);
+        appendBytes(tailBytes);
+        attach(image.data(), image.size());
+    }
+
+    ~LoudsTrie() {
+        if (map != NULL)
+            munmap(map, mapSize);
+    }
+
+    LoudsTrie(const LoudsTrie &) = delete;
+    LoudsTrie &operator=(const LoudsTrie &) = delete;
+
+    // Function to write the image to a file
+    bool save(const char *path) const {
+        FILE *file = fopen(path, "wb");
+        if (file == NULL) {
+            perror(path);
+            return false;
+        }
+        const uint64_t *base = map != NULL ? (const uint64_t *)map : image.data();
+        size_t length = map != NULL ? mapSize / 8 : image.size();
+        bool ok = fwrite(base, sizeof(uint64_t), length, file) == length;
+        ok = fclose(file) == 0 && ok;
+        if (!ok)
+            perror(path);
+        return ok;
+    }
+
+    // Function to map a file written by save()
+    // read-only and serve lookups straight from
+    // it, without copying or parsing
+    bool load(const char *path) {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            perror(path);
+            return false;
+        }
+        struct stat st;
+        fstat(fd, &st);
+        void *mapped = st.st_size > 0
+            ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            perror("mmap");
+            return false;
+        }
+
+        if (!attach((const uint64_t *)mapped, st.st_size / 8)) {
+            fprintf(stderr, "%s is not a frozen trie\n", path);
+            munmap(mapped, st.st_size);
+            return false;
+        }
+        if (map != NULL)
+            munmap(map, mapSize);
+        image.clear();
+        image.shrink_to_fit();
+        map = mapped;
+        mapSize = st.st_size;
+        return true;
+    }
+
+    // Function to search a word
+    bool search(string_view word) const {
+        int64_t node = nodes ? descend(word, false) : -1;
+        return node >= 0 && terminal.get(node);
+    }
+
+    // Function to search the prefix
+    bool startsWith(string_view prefix) const {
+        return prefix.empty() || (nodes && descend(prefix, true) >= 0);
+    }
+
+    // Function to return the size of the image
+    size_t sizeInBytes() const {
+        return map != NULL ? mapSize : image.size() * sizeof(uint64_t);
+    }
+};
+
+// Function that creates n random lowercase
+// words sharing prefixes the way dictionary
+// words do: each word extends a random
+// prefix of the word before it
+vector<string> randomWords(int n, unsigned seed) {
+    mt19937 rng(seed);
+    vector<string> words;
+    string last;
+    for (int i = 0; i < n; i++) {
+        string word = last.substr(0, last.empty() ? 0 : rng() % last.length());
+        int extra = 3 + rng() % 8;
+        for (int j = 0; j < extra; j++)
+            word += (char)('a' + rng() % 26);
+        words.push_back(word);
+        last = word;
+    }
+    return words;
+}
+
+// Function to return the seconds
+// elapsed since start
+double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Benchmark: build a trie of n words, print
+// its memory use and time lookups of every word
+void benchmark(int n) {
+    vector<string> words = randomWords(n, 1);
+    Trie trie;
+
+    auto start = chrono::steady_clock::now();
+    for (const string &word : words)
+        trie.insert(word);
+    double insertTime = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    int found = 0;
+    for (const string &word : words)
+        found += trie.search(word);
+    double searchTime = secondsSince(start);
+
+    cout << n << " words: insert " << insertTime << " s, search " << searchTime
+         << " s, found " << found << endl;
+    trie.printStats();
+}
+
+// Benchmark: look up n keys stored back to
+// back in one buffer, once through string_view
+// and once through a std::string built per
+// lookup as the by-value API used to require
+void benchmarkLookups(int n) {
+    vector<string> words = randomWords(n, 2);
+    Trie trie;
+    for (int i = 0; i < n; i += 2)
+        trie.insert(words[i]);
+
+    string buffer;
+    vector<pair<size_t, size_t>> spans;
+    for (const string &word : words) {
+        spans.push_back({buffer.size(), word.size()});
+        buffer += word;
+    }
+
+    auto start = chrono::steady_clock::now();
+    int found = 0;
+    for (const auto &span : spans)
+        found += trie.search(string_view(buffer.data() + span.first, span.second));
+    double viewTime = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    int copiedFound = 0;
+    for (const auto &span : spans)
+        copiedFound += trie.search(string(buffer, span.first, span.second));
+    double copyTime = secondsSince(start);
+
+    cout << "string_view lookups: " << n / viewTime / 1e6 << " M/s, found " << found
+         << endl;
+    cout << "std::string lookups: " << n / copyTime / 1e6 << " M/s, found "
+         << copiedFound << endl;
+}
+
+// Benchmark: build a trie of n words, erase
+// every other one and reinsert them a few
+// times, then compare its shape with a trie
+// freshly built from the same words
+void benchmarkChurn(int n) {
+    // randomWords() can repeat a word, and a repeat would be
+    // erased by both halves. Keep one copy of each, in random
+    // order, so the fresh build holds exactly the survivors
+    vector<string> words = randomWords(n, 3);
+    sort(words.begin(), words.end());
+    words.erase(unique(words.begin(), words.end()), words.end());
+    shuffle(words.begin(), words.end(), mt19937(3));
+    n = (int)words.size();
+
+    Trie trie;
+    for (const string &word : words)
+        trie.insert(word);
+
+    auto start = chrono::steady_clock::now();
+    int erased = 0;
+    for (int round = 0; round < 3; round++) {
+        for (int i = round % 2; i < n; i += 2)
+            erased += trie.erase(words[i]);
+        for (int i = round % 2; i < n; i += 2)
+            trie.insert(words[i]);
+    }
+    for (int i = 0; i < n; i += 2)
+        erased += trie.erase(words[i]);
+    double churnTime = secondsSince(start);
+
+    cout << "Churn: " << erased << " erases in " << churnTime << " s" << endl;
+    trie.printStats();
+
+    Trie fresh;
+    for (int i = 1; i < n; i += 2)
+        fresh.insert(words[i]);
+    cout << "Fresh build of the survivors:" << endl;
+    fresh.printStats();
+}
+
+// Benchmark: build a trie of n scored words
+// and time top-k completions of prefixes
+// of 1 to 3 bytes taken from the words
+void benchmarkTopK(int n, int queries, int k) {
+    vector<string> words = randomWords(n, 4);
+    mt19937 rng(5);
+    Trie trie;
+    for (const string &word : words)
+        trie.insert(word, rng() % 1000000);
+
+    vector<Completion> results(k);
+    vector<char> text(64 * k);
+    vector<double> latencies(queries);
+    double total = 0;
+    long long returned = 0;
+    for (int q = 0; q < queries; q++) {
+        const string &word = words[rng() % n];
+        string_view prefix(word.data(), min<size_t>(word.length(), 1 + q % 3));
+
+        auto start = chrono::steady_clock::now();
+        returned += trie.complete(prefix, k, results.data(), text.data(), text.size());
+        latencies[q] = secondsSince(start);
+        total += latencies[q];
+    }
+    sort(latencies.begin(), latencies.end());
+
+    cout << "Top-" << k << " over " << n << " words: " << total / queries * 1e6
+         << " us average, " << latencies[queries * 99 / 100] * 1e6 << " us p99, "
+         << returned << " results" << endl;
+}
+
+// Function to time a search of every word
+template <typename T>
+void timeSearches(const char *name, T &trie, const vector<string> &words) {
+    auto start = chrono::steady_clock::now();
+    int found = 0;
+    for (const string &word : words)
+        found += trie.search(word);
+    cout << name << ": " << words.size() / secondsSince(start) / 1e6
+         << " M lookups/s, found " << found << endl;
+}
+
+// Benchmark: freeze a trie of n words, save
+// it, map it back and compare memory use and
+// lookup speed of the three forms
+void benchmarkFrozen(int n, const char *path) {
+    vector<string> words = randomWords(n, 6);
+    Trie trie;
+    for (const string &word : words)
+        trie.insert(word);
+    trie.printStats();
+
+    auto start = chrono::steady_clock::now();
+    LoudsTrie frozen(trie);
+    cout << "Frozen in " << secondsSince(start) << " s to " << frozen.sizeInBytes()
+         << " bytes" << endl;
+
+    LoudsTrie mapped;
+    if (!frozen.save(path) || !mapped.load(path))
+        return;
+
+    timeSearches("Trie", trie, words);
+    timeSearches("Frozen", frozen, words);
+    timeSearches("Mapped", mapped, words);
+    unlink(path);
+}
+
 // Driver code
 int main() {
     Trie trie;
@@ -187,6 +1500,54 @@ int main() {
     cout << trie.startsWith("th") << endl;
     cout << trie.startsWith("fab") << endl;
 
+    // Freeze the trie for read-only use
+    LoudsTrie frozen(trie);
+    cout << frozen.search("there") << endl;
+    cout << frozen.search("therein") << endl;
+    cout << frozen.startsWith("th") << endl;
+    cout << frozen.startsWith("fab") << endl;
+
+    // Keys are arbitrary bytes, so UTF-8
+    // paths, digits and upper case all work
+    Trie paths;
+    paths.insert("/home/José/Документы/2024");
+    paths.insert("/home/José/Документы/2025");
+    paths.insert("/home/José/写真");
+    paths.insert("/home/Zoë");
+    paths.insert("/Home");
+    paths.print();
+    cout << paths.search("/home/José/写真") << endl;
+    cout << paths.startsWith("/home/José/Док") << endl;
+
+    // Deleting re-merges the edges the
+    // deleted word had split
+    cout << paths.erase("/home/José/Документы/2024") << endl;
+    cout << paths.erase("/home/José/Документы/2024") << endl;
+    cout << paths.erase("/home/Zoë") << endl;
+    paths.print();
+
+    // Top 3 completions of "th" by score
+    Trie scored;
+    scored.insert("the", 500);
+    scored.insert("then", 120);
+    scored.insert("there", 300);
+    scored.insert("this", 450);
+    scored.insert("thistle", 20);
+    scored.insert("face", 900);
+
+    Completion results[3];
+    char text[64];
+    int found = scored.complete("th", 3, results, text, sizeof(text));
+    for (int i = 0; i < found; i++)
+        cout << string_view(text + results[i].offset, results[i].length) << " "
+             << results[i].score << endl;
+
+    benchmark(1000000);
+    benchmarkLookups(1000000);
+    benchmarkChurn(1000000);
+    benchmarkTopK(1000000, 100000, 10);
+    benchmarkFrozen(1000000, "trie.louds");
+
     return 0;
 }
 //This code is contributed by Aman.
\ No newline at end of file
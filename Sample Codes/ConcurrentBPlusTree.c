@@ -0,0 +1,488 @@
+// C Program to Implement a concurrent B+ Tree with
+// optimistic lock coupling
+// compile: gcc -O2 -pthread ConcurrentBPlusTree.c
+//
+// Every node carries a version lock. Readers never write to
+// shared memory: they remember a node's version, read the
+// node, and check the version afterwards, restarting from the
+// root if a writer got in between. Writers take the lock only
+// on the nodes they modify by upgrading the version they read.
+// Nodes are only ever split, never merged or freed while the
+// tree is in use, so a reader can always finish reading the
+// node it holds and needs no reclamation scheme.
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "BenchThreads.h"
+
+// Maximum number of keys in a node
+#define MAX_KEYS 64
+
+// Version word: bit 1 is set while a writer holds the lock,
+// the bits above it count writes. Locking adds 2 (sets bit
+// 1), unlocking adds 2 again (clears it and carries into the
+// counter)
+#define LOCKED_BIT 2u
+
+typedef struct Node {
+    // Version lock
+    _Atomic uint64_t version;
+    // To determine whether the node is leaf or not
+    bool leaf;
+    // Current number of keys
+    int n;
+    // Array of keys, keys equal to a separator live in the
+    // right subtree
+    int keys[MAX_KEYS];
+    union {
+        // Child pointers of an internal node
+        struct Node *children[MAX_KEYS + 1];
+        // Values of a leaf
+        int values[MAX_KEYS];
+    };
+} Node;
+
+typedef struct BTree {
+    _Atomic(Node *) root;
+} BTree;
+
+// Function to create a new node
+Node *createNode(bool leaf) {
+    Node *node = (Node *)calloc(1, sizeof(Node));
+    atomic_init(&node->version, 4);
+    node->leaf = leaf;
+    return node;
+}
+
+BTree *createBTree() {
+    BTree *btree = (BTree *)malloc(sizeof(BTree));
+    atomic_init(&btree->root, createNode(true));
+    return btree;
+}
+
+// Version lock ---------------------------------------------
+
+// Function to wait until the node is unlocked and return its
+// version
+uint64_t readLock(Node *node) {
+    uint64_t version = atomic_load_explicit(&node->version, memory_order_acquire);
+    while (version & LOCKED_BIT) {
+        sched_yield();
+        version = atomic_load_explicit(&node->version, memory_order_acquire);
+    }
+    return version;
+}
+
+// Function to check that nothing was written to the node
+// since version was read, everything read in between is
+// only trusted if this succeeds
+void checkVersion(Node *node, uint64_t version, bool *restart) {
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&node->version, memory_order_relaxed) != version)
+        *restart = true;
+}
+
+// Function to turn a read into a write lock, fails (and sets
+// *restart) if the node changed since version was read
+void upgradeLock(Node *node, uint64_t version, bool *restart) {
+    if (!atomic_compare_exchange_strong(&node->version, &version,
+            version + LOCKED_BIT))
+        *restart = true;
+}
+
+void writeUnlock(Node *node) { atomic_fetch_add(&node->version, LOCKED_BIT); }
+
+// Node operations, callers hold the right locks -------------
+
+// Function to count the keys smaller than key
+int findKey(Node *node, int key) {
+    int lo = 0, hi = node->n;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (node->keys[mid] < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// Function to find the child to descend into for a key
+int findChild(Node *node, int key) {
+    int lo = 0, hi = node->n;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (node->keys[mid] <= key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// Function to split a full node, the upper half goes to a new
+// node and the separator for the parent goes to *separator
+Node *splitNode(Node *node, int *separator) {
+    Node *newNode = createNode(node->leaf);
+    int mid = node->n / 2;
+    if (node->leaf) {
+        newNode->n = node->n - mid;
+        for (int i = 0; i < newNode->n; i++) {
+            newNode->keys[i] = node->keys[mid + i];
+            newNode->values[i] = node->values[mid + i];
+        }
+        *separator = newNode->keys[0];
+    } else {
+        newNode->n = node->n - mid - 1;
+        for (int i = 0; i < newNode->n; i++) {
+            newNode->keys[i] = node->keys[mid + 1 + i];
+        }
+        for (int i = 0; i <= newNode->n; i++) {
+            newNode->children[i] = node->children[mid + 1 + i];
+        }
+        *separator = node->keys[mid];
+    }
+    node->n = mid;
+    return newNode;
+}
+
+// Function to add a separator and the child to its right to
+// a node that is not full
+void insertChild(Node *node, int separator, Node *child) {
+    int pos = findChild(node, separator);
+    for (int i = node->n; i > pos; i--) {
+        node->keys[i] = node->keys[i - 1];
+        node->children[i + 1] = node->children[i];
+    }
+    node->keys[pos] = separator;
+    node->children[pos + 1] = child;
+    node->n++;
+}
+
+// Function to put a new root above a split root
+void makeRoot(BTree *btree, int separator, Node *left, Node *right) {
+    Node *root = createNode(false);
+    root->n = 1;
+    root->keys[0] = separator;
+    root->children[0] = left;
+    root->children[1] = right;
+    atomic_store(&btree->root, root);
+}
+
+// Tree operations ------------------------------------------
+
+// Function to search a key, its value goes to *value
+bool search(BTree *btree, int key, int *value) {
+    for (;;) {
+        bool restart = false;
+        Node *node = atomic_load(&btree->root);
+        uint64_t version = readLock(node);
+        if (restart || node != atomic_load(&btree->root))
+            continue;
+
+        Node *parent = NULL;
+        uint64_t parentVersion = 0;
+        while (!node->leaf) {
+            Node *child = node->children[findChild(node, key)];
+
+            // Parent is no longer needed once node is known to
+            // be consistent
+            if (parent != NULL) {
+                checkVersion(parent, parentVersion, &restart);
+                if (restart)
+                    break;
+            }
+            parent = node;
+            parentVersion = version;
+
+            // child must be validated before it is touched
+            checkVersion(node, version, &restart);
+            if (restart)
+                break;
+            node = child;
+            version = readLock(node);
+            if (restart)
+                break;
+        }
+        if (restart)
+            continue;
+
+        int pos = findKey(node, key);
+        bool found = pos < node->n && node->keys[pos] == key;
+        int result = found ? node->values[pos] : 0;
+        if (parent != NULL)
+            checkVersion(parent, parentVersion, &restart);
+        checkVersion(node, version, &restart);
+        if (restart)
+            continue;
+        if (found && value != NULL)
+            *value = result;
+        return found;
+    }
+}
+
+// Function to insert a key, or update its value. Full nodes
+// met on the way down are split right away with the parent
+// and the node write-locked, then the operation restarts, so
+// a leaf insert only ever locks the leaf
+void insert(BTree *btree, int key, int value) {
+    for (;;) {
+        bool restart = false;
+        Node *node = atomic_load(&btree->root);
+        uint64_t version = readLock(node);
+        if (restart || node != atomic_load(&btree->root))
+            continue;
+
+        Node *parent = NULL;
+        uint64_t parentVersion = 0;
+        for (;;) {
+            if (node->n == MAX_KEYS) {
+                // Lock parent then node, the versions make sure
+                // neither changed since they were read
+                if (parent != NULL) {
+                    upgradeLock(parent, parentVersion, &restart);
+                    if (restart)
+                        break;
+                }
+                upgradeLock(node, version, &restart);
+                if (restart) {
+                    if (parent != NULL)
+                        writeUnlock(parent);
+                    break;
+                }
+                if (parent == NULL && node != atomic_load(&btree->root)) {
+                    writeUnlock(node);
+                    restart = true;
+                    break;
+                }
+                int separator;
+                Node *newNode = splitNode(node, &separator);
+                if (parent != NULL)
+                    insertChild(parent, separator, newNode);
+                else
+                    makeRoot(btree, separator, node, newNode);
+                writeUnlock(node);
+                if (parent != NULL)
+                    writeUnlock(parent);
+                restart = true;
+                break;
+            }
+            if (node->leaf)
+                break;
+
+            if (parent != NULL) {
+                checkVersion(parent, parentVersion, &restart);
+                if (restart)
+                    break;
+            }
+            parent = node;
+            parentVersion = version;
+            Node *child = node->children[findChild(node, key)];
+            checkVersion(node, version, &restart);
+            if (restart)
+                break;
+            node = child;
+            version = readLock(node);
+            if (restart)
+                break;
+        }
+        if (restart)
+            continue;
+
+        // Leaf with room: lock it alone
+        upgradeLock(node, version, &restart);
+        if (restart)
+            continue;
+        if (parent != NULL) {
+            checkVersion(parent, parentVersion, &restart);
+            if (restart) {
+                writeUnlock(node);
+                continue;
+            }
+        }
+        int pos = findKey(node, key);
+        if (pos < node->n && node->keys[pos] == key) {
+            node->values[pos] = value;
+        } else {
+            for (int i = node->n; i > pos; i--) {
+                node->keys[i] = node->keys[i - 1];
+                node->values[i] = node->values[i - 1];
+            }
+            node->keys[pos] = key;
+            node->values[pos] = value;
+            node->n++;
+        }
+        writeUnlock(node);
+        return;
+    }
+}
+
+// Function to delete a key. Only the leaf is locked and the
+// key removed, nodes are never merged, so no node is ever
+// freed while a reader may still be looking at it
+bool deleteKey(BTree *btree, int key) {
+    for (;;) {
+        bool restart = false;
+        Node *node = atomic_load(&btree->root);
+        uint64_t version = readLock(node);
+        if (restart || node != atomic_load(&btree->root))
+            continue;
+
+        Node *parent = NULL;
+        uint64_t parentVersion = 0;
+        while (!node->leaf) {
+            Node *child = node->children[findChild(node, key)];
+            if (parent != NULL) {
+                checkVersion(parent, parentVersion, &restart);
+                if (restart)
+                    break;
+            }
+            parent = node;
+            parentVersion = version;
+            checkVersion(node, version, &restart);
+            if (restart)
+                break;
+            node = child;
+            version = readLock(node);
+            if (restart)
+                break;
+        }
+        if (restart)
+            continue;
+
+        // The parent check makes sure the leaf was not split
+        // between reading its pointer and locking it
+        upgradeLock(node, version, &restart);
+        if (restart)
+            continue;
+        if (parent != NULL) {
+            checkVersion(parent, parentVersion, &restart);
+            if (restart) {
+                writeUnlock(node);
+                continue;
+            }
+        }
+        int pos = findKey(node, key);
+        bool found = pos < node->n && node->keys[pos] == key;
+        if (found) {
+            for (int i = pos + 1; i < node->n; i++) {
+                node->keys[i - 1] = node->keys[i];
+                node->values[i - 1] = node->values[i];
+            }
+            node->n--;
+        }
+        writeUnlock(node);
+        return found;
+    }
+}
+
+// Function to free a subtree, no other thread may use it
+void freeTree(Node *node) {
+    if (!node->leaf) {
+        for (int i = 0; i <= node->n; i++) {
+            freeTree(node->children[i]);
+        }
+    }
+    free(node);
+}
+
+// Benchmark ------------------------------------------------
+
+#define BENCH_KEYS 1000000
+#define BENCH_OPS_PER_THREAD 1000000
+#define BENCH_MAX_THREADS 64
+
+struct benchArgs {
+    BTree *btree;
+    unsigned int seed;
+    int writePercent;
+    long found;
+};
+
+void *benchWorker(void *arg) {
+    struct benchArgs *args = (struct benchArgs *)arg;
+    unsigned int x = args->seed;
+    long found = 0;
+    for (int i = 0; i < BENCH_OPS_PER_THREAD; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        int key = (int)(x % (2u * BENCH_KEYS));
+        if ((int)(x >> 24) % 100 < args->writePercent) {
+            insert(args->btree, key, key);
+        } else {
+            found += search(args->btree, key, NULL);
+        }
+    }
+    args->found = found;
+    return NULL;
+}
+
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Function to run one read/write mix for 1 to maxThreads
+void benchmarkMix(int maxThreads, int writePercent) {
+    BTree *btree = createBTree();
+    for (int i = 0; i < BENCH_KEYS; i++) {
+        int key = (int)((i * 2654435761u) % (2u * BENCH_KEYS));
+        insert(btree, key, key);
+    }
+    printf("%d%% writes\nthreads   Mops/s   speedup\n", writePercent);
+
+    double base = 0;
+    for (int threads = 1; threads > 0;
+         threads = nextThreadCount(threads, maxThreads)) {
+        pthread_t tid[BENCH_MAX_THREADS];
+        struct benchArgs args[BENCH_MAX_THREADS];
+        double start = now();
+        for (int i = 0; i < threads; i++) {
+            args[i].btree = btree;
+            args[i].seed = 2463534242U + i * 7919;
+            args[i].writePercent = writePercent;
+            pthread_create(&tid[i], NULL, benchWorker, &args[i]);
+        }
+        for (int i = 0; i < threads; i++) {
+            pthread_join(tid[i], NULL);
+        }
+        double mops = (double)threads * BENCH_OPS_PER_THREAD
+            / (now() - start) / 1e6;
+        if (threads == 1)
+            base = mops;
+        printf("%7d %8.2f %8.2fx\n", threads, mops, mops / base);
+    }
+    printf("\n");
+    freeTree(atomic_load(&btree->root));
+    free(btree);
+}
+
+int main(int argc, char *argv[]) {
+    int maxThreads = argc > 1 ? atoi(argv[1]) : 8;
+    if (maxThreads < 1 || maxThreads > BENCH_MAX_THREADS)
+        maxThreads = BENCH_MAX_THREADS;
+
+    BTree *btree = createBTree();
+    for (int i = 1; i <= 10; i++) {
+        insert(btree, i * 3, i * 30);
+    }
+    deleteKey(btree, 9);
+    int value = 0;
+    bool found = search(btree, 12, &value);
+    printf("Key 12 %s, value %d\n", found ? "found" : "not found", value);
+    printf("Key 9 %s\n\n", search(btree, 9, NULL) ? "found" : "not found");
+    freeTree(atomic_load(&btree->root));
+    free(btree);
+
+    benchmarkMix(maxThreads, 0);
+    benchmarkMix(maxThreads, 5);
+    benchmarkMix(maxThreads, 50);
+    return 0;
+}
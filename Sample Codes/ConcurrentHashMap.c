@@ -0,0 +1,452 @@
+// Sharded concurrent version of HashMap.c
+// compile: gcc -O2 -pthread ConcurrentHashMap.c
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include "BenchThreads.h"
+
+// Number of shards, a power of two, each with its own lock
+#define NUM_SHARDS 64
+
+// Initial capacity of one shard, a power of two
+#define INITIAL_CAPACITY 16
+
+// Grow a shard when its load factor goes above
+// MAX_LOAD_NUM / MAX_LOAD_DEN (0.75)
+#define MAX_LOAD_NUM 3
+#define MAX_LOAD_DEN 4
+
+// Number of leading key bytes kept inside the node
+#define KEY_PREFIX 8
+
+// Size of one block of a shard's string arena
+#define ARENA_BLOCK_SIZE (1 << 20)
+
+// A shard's arena is compacted once more than half of it,
+// and more than this many bytes, belong to deleted entries
+#define MIN_DEAD_BYTES 4096
+
+// Linked List node, same layout as HashMap.c
+struct node {
+
+    // full hash of the key, compared before anything else
+    uint32_t hash;
+
+    // length of the key in bytes
+    uint32_t keyLen;
+
+    // first KEY_PREFIX bytes of the key, zero padded
+    char prefix[KEY_PREFIX];
+
+    // key and value stored in the arena as "key\0value\0"
+    char *key;
+    struct node *next;
+};
+
+// One block of the string arena
+struct arenaBlock {
+    struct arenaBlock *next;
+    size_t used, size;
+    char data[];
+};
+
+// One shard is a plain chained hash map guarded by a
+// reader-writer lock, aligned so two shards never share
+// a cache line
+struct shard {
+    pthread_rwlock_t lock;
+    int numOfElements, capacity;
+    unsigned int mask;
+    struct node **arr;
+    struct arenaBlock *arena;
+    // Bytes copied into the arena, and how many of them
+    // belong to deleted entries
+    size_t arenaBytes, deadBytes;
+} __attribute__((aligned(64)));
+
+struct concurrentHashMap {
+    struct shard shards[NUM_SHARDS];
+};
+
+// Value is stored right after the key
+char *nodeValue(struct node *node) {
+    return node->key + node->keyLen + 1;
+}
+
+// like constructor
+void initializeHashMap(struct concurrentHashMap *mp) {
+    for (int i = 0; i < NUM_SHARDS; i++) {
+        struct shard *sh = &mp->shards[i];
+        pthread_rwlock_init(&sh->lock, NULL);
+        sh->numOfElements = 0;
+        sh->capacity = INITIAL_CAPACITY;
+        sh->mask = INITIAL_CAPACITY - 1;
+        sh->arr = (struct node **)calloc(sh->capacity,
+            sizeof(struct node *));
+        sh->arena = NULL;
+        sh->arenaBytes = sh->deadBytes = 0;
+    }
+    return;
+}
+
+// Hash of the whole key, see HashMap.c
+uint32_t hashString(const char *key, uint32_t *keyLen) {
+    uint32_t hash = 0;
+    const char *start = key;
+    for (; *key != '\0'; key++) {
+        hash = hash * 31 + (unsigned char)*key;
+    }
+    *keyLen = (uint32_t)(key - start);
+    hash ^= hash >> 16;
+    hash *= 0x45d9f3bU;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+// The shard comes from the top bits of the hash, the
+// bucket inside it from the bottom bits
+struct shard *shardFor(struct concurrentHashMap *mp,
+    uint32_t hash) {
+    return &mp->shards[hash >> 26 & (NUM_SHARDS - 1)];
+}
+
+// Copies key and value into the shard's arena
+char *arenaCopy(struct shard *sh, const char *key, size_t keyLen,
+    const char *value, size_t valueLen) {
+    size_t need = keyLen + valueLen + 2;
+    struct arenaBlock *block = sh->arena;
+    if (block == NULL || block->size - block->used < need) {
+        size_t size = need > ARENA_BLOCK_SIZE ? need
+                                              : ARENA_BLOCK_SIZE;
+        block = (struct arenaBlock *)malloc(
+            sizeof(struct arenaBlock) + size);
+        if (block == NULL) {
+            return NULL;
+        }
+        block->size = size;
+        block->used = 0;
+        block->next = sh->arena;
+        sh->arena = block;
+    }
+    char *data = block->data + block->used;
+    memcpy(data, key, keyLen + 1);
+    memcpy(data + keyLen + 1, value, valueLen + 1);
+    block->used += need;
+    sh->arenaBytes += need;
+    return data;
+}
+
+// Copies every live entry of a shard into one fresh block,
+// dropping the bytes of deleted ones. Caller holds the
+// write lock; if the block cannot be allocated the old
+// arena is kept
+void compactArena(struct shard *sh) {
+    size_t live = sh->arenaBytes - sh->deadBytes;
+    struct arenaBlock *block = (struct arenaBlock *)malloc(
+        sizeof(struct arenaBlock) + live);
+    if (block == NULL) {
+        return;
+    }
+    block->size = live;
+    block->used = 0;
+    block->next = NULL;
+    for (int i = 0; i < sh->capacity; i++) {
+        for (struct node *currNode = sh->arr[i]; currNode != NULL;
+             currNode = currNode->next) {
+            size_t need = currNode->keyLen + 1
+                + strlen(nodeValue(currNode)) + 1;
+            char *data = block->data + block->used;
+            memcpy(data, currNode->key, need);
+            currNode->key = data;
+            block->used += need;
+        }
+    }
+    while (sh->arena != NULL) {
+        struct arenaBlock *next = sh->arena->next;
+        free(sh->arena);
+        sh->arena = next;
+    }
+    sh->arena = block;
+    sh->arenaBytes = live;
+    sh->deadBytes = 0;
+}
+
+int nodeMatches(struct node *node, uint32_t hash, const char *key,
+    uint32_t keyLen) {
+    if (node->hash != hash || node->keyLen != keyLen) {
+        return 0;
+    }
+    if (keyLen <= KEY_PREFIX) {
+        return memcmp(node->prefix, key, keyLen) == 0;
+    }
+    return memcmp(node->prefix, key, KEY_PREFIX) == 0
+        && memcmp(node->key + KEY_PREFIX, key + KEY_PREFIX,
+               keyLen - KEY_PREFIX)
+        == 0;
+}
+
+// Doubles one shard, caller holds its write lock
+void resizeShard(struct shard *sh) {
+    int newCapacity = sh->capacity * 2;
+    struct node **newArr = (struct node **)calloc(newCapacity,
+        sizeof(struct node *));
+    if (newArr == NULL) {
+        return;
+    }
+    sh->capacity = newCapacity;
+    sh->mask = newCapacity - 1;
+    for (int i = 0; i < newCapacity / 2; i++) {
+        struct node *currNode = sh->arr[i];
+        while (currNode != NULL) {
+            struct node *nextNode = currNode->next;
+            int bucketIndex = currNode->hash & sh->mask;
+            currNode->next = newArr[bucketIndex];
+            newArr[bucketIndex] = currNode;
+            currNode = nextNode;
+        }
+    }
+    free(sh->arr);
+    sh->arr = newArr;
+    return;
+}
+
+void insert(struct concurrentHashMap *mp, const char *key,
+    const char *value) {
+    uint32_t keyLen;
+    uint32_t hash = hashString(key, &keyLen);
+    struct shard *sh = shardFor(mp, hash);
+
+    // Node is built before taking the lock, only the
+    // arena copy and linking happen inside it
+    struct node *newNode = (struct node *)malloc(sizeof(struct node));
+    if (newNode == NULL) {
+        return;
+    }
+    newNode->hash = hash;
+    newNode->keyLen = keyLen;
+    memset(newNode->prefix, 0, KEY_PREFIX);
+    memcpy(newNode->prefix, key,
+        keyLen < KEY_PREFIX ? keyLen : KEY_PREFIX);
+
+    pthread_rwlock_wrlock(&sh->lock);
+    newNode->key = arenaCopy(sh, key, keyLen, value, strlen(value));
+    if (newNode->key == NULL) {
+        pthread_rwlock_unlock(&sh->lock);
+        free(newNode);
+        return;
+    }
+    if ((long long)(sh->numOfElements + 1) * MAX_LOAD_DEN
+        > (long long)sh->capacity * MAX_LOAD_NUM) {
+        resizeShard(sh);
+    }
+
+    // Insertion at head of the bucket's linked list
+    int bucketIndex = hash & sh->mask;
+    newNode->next = sh->arr[bucketIndex];
+    sh->arr[bucketIndex] = newNode;
+    sh->numOfElements++;
+    pthread_rwlock_unlock(&sh->lock);
+    return;
+}
+
+void delete (struct concurrentHashMap *mp, const char *key) {
+    uint32_t keyLen;
+    uint32_t hash = hashString(key, &keyLen);
+    struct shard *sh = shardFor(mp, hash);
+
+    pthread_rwlock_wrlock(&sh->lock);
+    struct node **link = &sh->arr[hash & sh->mask];
+    while (*link != NULL) {
+        struct node *currNode = *link;
+        if (nodeMatches(currNode, hash, key, keyLen)) {
+            *link = currNode->next;
+            sh->deadBytes += keyLen + 1 + strlen(nodeValue(currNode)) + 1;
+            free(currNode);
+            sh->numOfElements--;
+            break;
+        }
+        link = &currNode->next;
+    }
+    if (sh->deadBytes > MIN_DEAD_BYTES
+        && sh->deadBytes > sh->arenaBytes / 2) {
+        compactArena(sh);
+    }
+    pthread_rwlock_unlock(&sh->lock);
+    return;
+}
+
+// The value is copied into buf, cut to bufSize - 1 bytes,
+// while the read lock is held: once it is dropped a delete
+// may compact the arena. Returns buf, or the "Oops" string
+// if the key is missing
+char *search(struct concurrentHashMap *mp, const char *key, char *buf,
+    size_t bufSize) {
+    uint32_t keyLen;
+    uint32_t hash = hashString(key, &keyLen);
+    struct shard *sh = shardFor(mp, hash);
+    int found = 0;
+
+    pthread_rwlock_rdlock(&sh->lock);
+    struct node *bucketHead = sh->arr[hash & sh->mask];
+    while (bucketHead != NULL) {
+        if (nodeMatches(bucketHead, hash, key, keyLen)) {
+            const char *value = nodeValue(bucketHead);
+            size_t len = strlen(value);
+            if (len >= bufSize) {
+                len = bufSize - 1;
+            }
+            memcpy(buf, value, len);
+            buf[len] = '\0';
+            found = 1;
+            break;
+        }
+        bucketHead = bucketHead->next;
+    }
+    pthread_rwlock_unlock(&sh->lock);
+
+    if (!found) {
+        return "Oops! No data found.\n";
+    }
+    return buf;
+}
+
+// Total number of elements, shards are read one at a time
+int size(struct concurrentHashMap *mp) {
+    int total = 0;
+    for (int i = 0; i < NUM_SHARDS; i++) {
+        pthread_rwlock_rdlock(&mp->shards[i].lock);
+        total += mp->shards[i].numOfElements;
+        pthread_rwlock_unlock(&mp->shards[i].lock);
+    }
+    return total;
+}
+
+// like destructor, no other thread may use the map
+void freeHashMap(struct concurrentHashMap *mp) {
+    for (int i = 0; i < NUM_SHARDS; i++) {
+        struct shard *sh = &mp->shards[i];
+        for (int j = 0; j < sh->capacity; j++) {
+            struct node *currNode = sh->arr[j];
+            while (currNode != NULL) {
+                struct node *nextNode = currNode->next;
+                free(currNode);
+                currNode = nextNode;
+            }
+        }
+        free(sh->arr);
+        while (sh->arena != NULL) {
+            struct arenaBlock *next = sh->arena->next;
+            free(sh->arena);
+            sh->arena = next;
+        }
+        pthread_rwlock_destroy(&sh->lock);
+    }
+    return;
+}
+
+// Benchmark ------------------------------------------------
+
+#define BENCH_KEYS 1000000
+#define BENCH_OPS_PER_THREAD 2000000
+#define BENCH_MAX_THREADS 32
+
+// Percentage of operations that are writes
+#define BENCH_WRITE_PERCENT 1
+
+struct benchArgs {
+    struct concurrentHashMap *mp;
+    char (*keys)[16];
+    unsigned int seed;
+    long found;
+};
+
+void *benchWorker(void *arg) {
+    struct benchArgs *args = (struct benchArgs *)arg;
+    unsigned int x = args->seed;
+    long found = 0;
+    char value[16];
+    for (int i = 0; i < BENCH_OPS_PER_THREAD; i++) {
+
+        // xorshift, cheap enough not to dominate the loop
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        char *key = args->keys[x % BENCH_KEYS];
+        if (x / BENCH_KEYS % 100 < BENCH_WRITE_PERCENT) {
+            delete (args->mp, key);
+            insert(args->mp, key, key);
+        } else if (search(args->mp, key, value, sizeof(value))[0] == 'k') {
+            found++;
+        }
+    }
+    args->found = found;
+    return NULL;
+}
+
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Drivers code
+int main(int argc, char *argv[]) {
+    int maxThreads = argc > 1 ? atoi(argv[1]) : 8;
+    if (maxThreads < 1 || maxThreads > BENCH_MAX_THREADS) {
+        maxThreads = BENCH_MAX_THREADS;
+    }
+
+    struct concurrentHashMap *mp = (struct concurrentHashMap *)
+        aligned_alloc(64, sizeof(struct concurrentHashMap));
+    initializeHashMap(mp);
+
+    insert(mp, "Yogaholic", "Anjali");
+    insert(mp, "pluto14", "Vartika");
+    insert(mp, "decentBoy", "Mayank");
+    char value[64];
+    printf("%s\n", search(mp, "Yogaholic", value, sizeof(value)));
+    printf("%s\n", search(mp, "pluto14", value, sizeof(value)));
+    delete (mp, "decentBoy");
+    printf("%s\n", search(mp, "decentBoy", value, sizeof(value)));
+
+    char(*keys)[16] = malloc(sizeof(*keys) * BENCH_KEYS);
+    for (int i = 0; i < BENCH_KEYS; i++) {
+        snprintf(keys[i], sizeof(keys[i]), "key%d", i);
+        insert(mp, keys[i], keys[i]);
+    }
+    printf("Elements : %d, %d%% writes\n\n", size(mp),
+        BENCH_WRITE_PERCENT);
+    printf("threads   Mops/s   speedup\n");
+
+    double base = 0;
+    for (int threads = 1; threads > 0;
+         threads = nextThreadCount(threads, maxThreads)) {
+        pthread_t tid[BENCH_MAX_THREADS];
+        struct benchArgs args[BENCH_MAX_THREADS];
+        double start = now();
+        for (int i = 0; i < threads; i++) {
+            args[i].mp = mp;
+            args[i].keys = keys;
+            args[i].seed = 2463534242U + i * 7919;
+            pthread_create(&tid[i], NULL, benchWorker, &args[i]);
+        }
+        for (int i = 0; i < threads; i++) {
+            pthread_join(tid[i], NULL);
+        }
+        double mops = (double)threads * BENCH_OPS_PER_THREAD
+            / (now() - start) / 1e6;
+        if (threads == 1) {
+            base = mops;
+        }
+        printf("%7d %8.2f %8.2fx\n", threads, mops, mops / base);
+    }
+
+    freeHashMap(mp);
+    free(mp);
+    free(keys);
+    return 0;
+}
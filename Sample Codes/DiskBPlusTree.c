@@ -0,0 +1,757 @@
+// C Program to Implement a disk-resident B+ Tree
+// Nodes are fixed-size pages of one file, addressed by page id
+// and accessed through mmap or through a buffer pool, so
+// reopening the file gives the tree back without reinserting
+// anything
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Size of one page, every node occupies exactly one page
+#define PAGE_SIZE 4096
+
+// Marks a file written by this program
+#define MAGIC 0x52545042u
+
+// Address space reserved for the mapping (64 GiB), the file
+// grows inside it so page pointers never move
+#define MAX_PAGES (1u << 24)
+
+// File is extended this many pages at a time
+#define GROW_PAGES 256
+
+// Page 0 is the meta page, so 0 also means "no page"
+#define NO_PAGE 0
+
+// Smallest buffer pool, an insert pins up to four pages
+#define MIN_POOL_FRAMES 8
+
+// Usage count given to a frame on access. CLOCK takes one off
+// per pass, so internal pages survive more sweeps than leaves
+#define LEAF_USAGE 1
+#define INTERNAL_USAGE 3
+
+// Page 0: where the tree starts and how much is allocated
+typedef struct MetaPage {
+    uint32_t magic;
+    uint32_t pageSize;
+    // Page id of the root node
+    uint32_t root;
+    // Number of pages in use, including this one
+    uint32_t numPages;
+    // Number of keys in the tree
+    uint64_t numKeys;
+} MetaPage;
+
+// Header shared by leaf and internal pages
+typedef struct PageHeader {
+    // To determine whether the node is leaf or not
+    uint16_t leaf;
+    // Current number of keys
+    uint16_t n;
+    // Page id of the next leaf, NO_PAGE for the last one
+    uint32_t next;
+} PageHeader;
+
+#define LEAF_MAX ((PAGE_SIZE - sizeof(PageHeader)) / 8)
+#define INTERNAL_MAX ((PAGE_SIZE - sizeof(PageHeader) - 4) / 8)
+
+// Leaf page: sorted keys and the value stored with each
+typedef struct LeafPage {
+    PageHeader h;
+    int32_t keys[LEAF_MAX];
+    int32_t values[LEAF_MAX];
+} LeafPage;
+
+// Internal page: n separators and n + 1 child page ids,
+// keys equal to a separator live in the right subtree
+typedef struct InternalPage {
+    PageHeader h;
+    int32_t keys[INTERNAL_MAX];
+    uint32_t children[INTERNAL_MAX + 1];
+} InternalPage;
+
+typedef union Page {
+    char raw[PAGE_SIZE];
+    MetaPage meta;
+    PageHeader h;
+    LeafPage leaf;
+    InternalPage internal;
+} Page;
+
+_Static_assert(sizeof(Page) == PAGE_SIZE, "page layout must fill a page");
+
+// One buffer pool slot
+typedef struct Frame {
+    // Page held by the frame, only meaningful while used is
+    // set, since NO_PAGE is also the id of the meta page
+    uint32_t pid;
+    // Number of getPage() calls not yet matched by putPage()
+    int pinCount;
+    // Frame must be written back before it is reused
+    bool dirty;
+    // Whether the frame holds a page at all
+    bool used;
+    // CLOCK counter, a frame is evicted when it reaches 0
+    int usage;
+} Frame;
+
+// Fixed set of page frames with CLOCK eviction
+typedef struct BufferPool {
+    int numFrames;
+    Frame *frames;
+    // numFrames pages, page i belongs to frames[i]
+    char *data;
+    // Page id -> frame index, open addressing, -1 when empty
+    int *table;
+    unsigned int tableMask;
+    // Next frame CLOCK looks at
+    int clockHand;
+    // Statistics
+    unsigned long long hits, misses, evictions, writeBacks;
+} BufferPool;
+
+// Maps page ids to memory
+typedef struct Pager {
+    int fd;
+    // Start of the reserved mapping, used when pool is NULL
+    char *map;
+    // Buffer pool, NULL in mmap mode
+    BufferPool *pool;
+    // Pages currently backed by the file
+    uint32_t filePages;
+} Pager;
+
+typedef struct DiskBTree {
+    Pager pager;
+} DiskBTree;
+
+// Function to create a buffer pool of numFrames pages
+BufferPool *createBufferPool(int numFrames) {
+    if (numFrames < MIN_POOL_FRAMES)
+        numFrames = MIN_POOL_FRAMES;
+    BufferPool *pool = (BufferPool *)calloc(1, sizeof(BufferPool));
+    pool->numFrames = numFrames;
+    pool->frames = (Frame *)calloc(numFrames, sizeof(Frame));
+    pool->data = (char *)aligned_alloc(PAGE_SIZE, (size_t)numFrames * PAGE_SIZE);
+    unsigned int tableSize = 1;
+    while (tableSize < 2u * numFrames)
+        tableSize *= 2;
+    pool->tableMask = tableSize - 1;
+    pool->table = (int *)malloc(tableSize * sizeof(int));
+    memset(pool->table, -1, tableSize * sizeof(int));
+    return pool;
+}
+
+void freeBufferPool(BufferPool *pool) {
+    free(pool->frames);
+    free(pool->data);
+    free(pool->table);
+    free(pool);
+}
+
+unsigned int poolSlot(BufferPool *pool, uint32_t pid) {
+    return (pid * 2654435761u) & pool->tableMask;
+}
+
+// Function to find the frame of a page, -1 if not cached
+int poolLookup(BufferPool *pool, uint32_t pid) {
+    for (unsigned int i = poolSlot(pool, pid);; i = (i + 1) & pool->tableMask) {
+        int frame = pool->table[i];
+        if (frame < 0 || pool->frames[frame].pid == pid)
+            return frame;
+    }
+}
+
+void poolMap(BufferPool *pool, uint32_t pid, int frame) {
+    unsigned int i = poolSlot(pool, pid);
+    while (pool->table[i] >= 0)
+        i = (i + 1) & pool->tableMask;
+    pool->table[i] = frame;
+}
+
+// Function to drop a page from the table, later entries of
+// the probe run are shifted back so lookups never stop early
+void poolUnmap(BufferPool *pool, uint32_t pid) {
+    unsigned int i = poolSlot(pool, pid);
+    while (pool->frames[pool->table[i]].pid != pid)
+        i = (i + 1) & pool->tableMask;
+    unsigned int hole = i;
+    for (i = (i + 1) & pool->tableMask; pool->table[i] >= 0;
+         i = (i + 1) & pool->tableMask) {
+        unsigned int home = poolSlot(pool, pool->frames[pool->table[i]].pid);
+        // Move the entry if its home is not inside (hole, i]
+        if (((i - home) & pool->tableMask) >= ((i - hole) & pool->tableMask)) {
+            pool->table[hole] = pool->table[i];
+            hole = i;
+        }
+    }
+    pool->table[hole] = -1;
+}
+
+// Function to write a dirty frame back to the file
+void writeBack(Pager *pager, int frame) {
+    BufferPool *pool = pager->pool;
+    Frame *f = &pool->frames[frame];
+    if (pwrite(pager->fd, pool->data + (size_t)frame * PAGE_SIZE, PAGE_SIZE,
+            (off_t)f->pid * PAGE_SIZE)
+        != PAGE_SIZE) {
+        perror("pwrite");
+        exit(EXIT_FAILURE);
+    }
+    f->dirty = false;
+    pool->writeBacks++;
+}
+
+// Function to pick a frame to reuse with CLOCK: pinned
+// frames are skipped, frames with usage left lose one and
+// get another chance, the first frame at 0 is the victim
+int evictFrame(Pager *pager) {
+    BufferPool *pool = pager->pool;
+    int maxUsage = INTERNAL_USAGE > LEAF_USAGE ? INTERNAL_USAGE : LEAF_USAGE;
+    for (int step = 0; step <= (maxUsage + 1) * pool->numFrames; step++) {
+        int frame = pool->clockHand;
+        Frame *f = &pool->frames[frame];
+        pool->clockHand = (pool->clockHand + 1) % pool->numFrames;
+        if (!f->used)
+            return frame;
+        if (f->pinCount > 0)
+            continue;
+        if (f->usage > 0) {
+            f->usage--;
+            continue;
+        }
+        if (f->dirty)
+            writeBack(pager, frame);
+        poolUnmap(pool, f->pid);
+        f->used = false;
+        pool->evictions++;
+        return frame;
+    }
+    fprintf(stderr, "Every buffer pool frame is pinned\n");
+    exit(EXIT_FAILURE);
+}
+
+// Function to get a page, the pointer stays valid until the
+// matching putPage(). With a buffer pool the page is pinned
+// in its frame and read from the file on a miss
+Page *getPage(Pager *pager, uint32_t pid) {
+    BufferPool *pool = pager->pool;
+    if (pool == NULL)
+        return (Page *)(pager->map + (size_t)pid * PAGE_SIZE);
+
+    int frame = poolLookup(pool, pid);
+    if (frame >= 0) {
+        pool->hits++;
+    } else {
+        pool->misses++;
+        frame = evictFrame(pager);
+        char *data = pool->data + (size_t)frame * PAGE_SIZE;
+        ssize_t got = pread(pager->fd, data, PAGE_SIZE, (off_t)pid * PAGE_SIZE);
+        if (got < 0) {
+            perror("pread");
+            exit(EXIT_FAILURE);
+        }
+        memset(data + got, 0, PAGE_SIZE - got);
+        Frame *f = &pool->frames[frame];
+        f->pid = pid;
+        f->used = true;
+        f->dirty = false;
+        f->pinCount = 0;
+        poolMap(pool, pid, frame);
+    }
+
+    Frame *f = &pool->frames[frame];
+    Page *page = (Page *)(pool->data + (size_t)frame * PAGE_SIZE);
+    f->pinCount++;
+    int usage = pid != 0 && page->h.leaf ? LEAF_USAGE : INTERNAL_USAGE;
+    if (f->usage < usage)
+        f->usage = usage;
+    return page;
+}
+
+// Function to release a page taken with getPage(). In mmap
+// mode dirty pages reach the file through the shared mapping,
+// with a buffer pool the frame is unpinned and marked dirty
+void putPage(Pager *pager, uint32_t pid, bool dirty) {
+    BufferPool *pool = pager->pool;
+    if (pool == NULL)
+        return;
+    Frame *f = &pool->frames[poolLookup(pool, pid)];
+    f->pinCount--;
+    f->dirty |= dirty;
+}
+
+// Function to write every dirty frame back to the file
+void flushPool(Pager *pager) {
+    BufferPool *pool = pager->pool;
+    for (int i = 0; i < pool->numFrames; i++) {
+        if (pool->frames[i].used && pool->frames[i].dirty)
+            writeBack(pager, i);
+    }
+}
+
+// Function to make sure the file backs the first numPages
+// pages, extending it GROW_PAGES at a time
+bool ensurePages(Pager *pager, uint32_t numPages) {
+    if (numPages <= pager->filePages)
+        return true;
+    if (numPages > MAX_PAGES)
+        return false;
+    uint32_t newPages = (numPages + GROW_PAGES - 1) / GROW_PAGES * GROW_PAGES;
+    if (newPages > MAX_PAGES)
+        newPages = MAX_PAGES;
+    if (ftruncate(pager->fd, (off_t)newPages * PAGE_SIZE) != 0)
+        return false;
+    pager->filePages = newPages;
+    return true;
+}
+
+// Function to allocate a zeroed page at the end of the file
+uint32_t allocPage(DiskBTree *tree) {
+    Page *metaPage = getPage(&tree->pager, 0);
+    uint32_t pid = metaPage->meta.numPages;
+    if (!ensurePages(&tree->pager, pid + 1)) {
+        putPage(&tree->pager, 0, false);
+        fprintf(stderr, "Cannot grow the index file\n");
+        exit(EXIT_FAILURE);
+    }
+    metaPage->meta.numPages++;
+    putPage(&tree->pager, 0, true);
+
+    Page *page = getPage(&tree->pager, pid);
+    memset(page, 0, PAGE_SIZE);
+    putPage(&tree->pager, pid, true);
+    return pid;
+}
+
+// Function to open an index file, creating an empty tree if
+// the file is new. poolFrames is the buffer pool size in
+// pages, 0 maps the whole file instead
+DiskBTree *openBTree(const char *path, int poolFrames) {
+    DiskBTree *tree = (DiskBTree *)malloc(sizeof(DiskBTree));
+    Pager *pager = &tree->pager;
+    pager->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (pager->fd < 0) {
+        perror(path);
+        free(tree);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(pager->fd, &st) < 0) {
+        perror(path);
+        close(pager->fd);
+        free(tree);
+        return NULL;
+    }
+
+    // Only an empty file becomes a new index. Anything else
+    // must be whole pages, a meta page and a root at least
+    if (st.st_size != 0
+        && (st.st_size % PAGE_SIZE != 0 || st.st_size < 2 * PAGE_SIZE
+            || st.st_size / PAGE_SIZE > MAX_PAGES)) {
+        fprintf(stderr, "%s is not an index file\n", path);
+        close(pager->fd);
+        free(tree);
+        return NULL;
+    }
+    pager->filePages = (uint32_t)(st.st_size / PAGE_SIZE);
+
+    // Reserve the whole range once, pages past the end of the
+    // file become usable as soon as the file grows over them
+    pager->pool = NULL;
+    pager->map = NULL;
+    if (poolFrames > 0) {
+        pager->pool = createBufferPool(poolFrames);
+    } else {
+        pager->map = (char *)mmap(NULL, (size_t)MAX_PAGES * PAGE_SIZE,
+            PROT_READ | PROT_WRITE, MAP_SHARED, pager->fd, 0);
+    }
+    if (pager->map == MAP_FAILED) {
+        perror("mmap");
+        close(pager->fd);
+        free(tree);
+        return NULL;
+    }
+
+    if (pager->filePages == 0) {
+        ensurePages(pager, 2);
+        Page *metaPage = getPage(pager, 0);
+        metaPage->meta.magic = MAGIC;
+        metaPage->meta.pageSize = PAGE_SIZE;
+        metaPage->meta.root = 1;
+        metaPage->meta.numPages = 2;
+        metaPage->meta.numKeys = 0;
+        putPage(pager, 0, true);
+
+        Page *root = getPage(pager, 1);
+        root->h.leaf = 1;
+        root->h.n = 0;
+        root->h.next = NO_PAGE;
+        putPage(pager, 1, true);
+    } else {
+        Page *metaPage = getPage(pager, 0);
+        bool valid = metaPage->meta.magic == MAGIC
+            && metaPage->meta.pageSize == PAGE_SIZE;
+        putPage(pager, 0, false);
+        if (!valid) {
+            fprintf(stderr, "%s is not an index file\n", path);
+            if (pager->pool != NULL)
+                freeBufferPool(pager->pool);
+            else
+                munmap(pager->map, (size_t)MAX_PAGES * PAGE_SIZE);
+            close(pager->fd);
+            free(tree);
+            return NULL;
+        }
+    }
+    return tree;
+}
+
+// Function to flush and close an index file
+void closeBTree(DiskBTree *tree) {
+    Pager *pager = &tree->pager;
+    if (pager->pool != NULL) {
+        flushPool(pager);
+        fsync(pager->fd);
+        freeBufferPool(pager->pool);
+    } else {
+        msync(pager->map, (size_t)pager->filePages * PAGE_SIZE, MS_SYNC);
+        munmap(pager->map, (size_t)MAX_PAGES * PAGE_SIZE);
+    }
+    close(pager->fd);
+    free(tree);
+}
+
+uint32_t rootPage(DiskBTree *tree) {
+    uint32_t root = getPage(&tree->pager, 0)->meta.root;
+    putPage(&tree->pager, 0, false);
+    return root;
+}
+
+// Function to count the keys of a page smaller than key
+int findKey(const int32_t *keys, int n, int key) {
+    int lo = 0, hi = n;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (keys[mid] < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// Function to find the child to descend into for a key
+int findChild(const int32_t *keys, int n, int key) {
+    int lo = 0, hi = n;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (keys[mid] <= key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// Function to find the leaf that holds key
+uint32_t findLeaf(DiskBTree *tree, int key) {
+    uint32_t pid = rootPage(tree);
+    for (;;) {
+        Page *page = getPage(&tree->pager, pid);
+        if (page->h.leaf) {
+            putPage(&tree->pager, pid, false);
+            return pid;
+        }
+        uint32_t child = page->internal.children[findChild(
+            page->internal.keys, page->h.n, key)];
+        putPage(&tree->pager, pid, false);
+        pid = child;
+    }
+}
+
+// Function to search a key, its value goes to *value
+bool search(DiskBTree *tree, int key, int *value) {
+    uint32_t pid = findLeaf(tree, key);
+    Page *page = getPage(&tree->pager, pid);
+    int i = findKey(page->leaf.keys, page->h.n, key);
+    bool found = i < page->h.n && page->leaf.keys[i] == key;
+    if (found && value != NULL)
+        *value = page->leaf.values[i];
+    putPage(&tree->pager, pid, false);
+    return found;
+}
+
+// Function to split the full child at index i of parent,
+// both pages are held by the caller. Same rules as the in
+// memory tree: a leaf separator is copied up, an internal
+// one is moved up
+void splitChild(DiskBTree *tree, Page *parent, int i, Page *child) {
+    uint32_t newPid = allocPage(tree);
+    Page *newChild = getPage(&tree->pager, newPid);
+    int n = child->h.n, mid = n / 2;
+    int32_t separator;
+
+    newChild->h.leaf = child->h.leaf;
+    if (child->h.leaf) {
+        newChild->h.n = n - mid;
+        memcpy(newChild->leaf.keys, child->leaf.keys + mid,
+            (n - mid) * sizeof(int32_t));
+        memcpy(newChild->leaf.values, child->leaf.values + mid,
+            (n - mid) * sizeof(int32_t));
+        separator = newChild->leaf.keys[0];
+        newChild->h.next = child->h.next;
+        child->h.next = newPid;
+        child->h.n = mid;
+    } else {
+        newChild->h.n = n - mid - 1;
+        memcpy(newChild->internal.keys, child->internal.keys + mid + 1,
+            (n - mid - 1) * sizeof(int32_t));
+        memcpy(newChild->internal.children, child->internal.children + mid + 1,
+            (n - mid) * sizeof(uint32_t));
+        separator = child->internal.keys[mid];
+        child->h.n = mid;
+    }
+    putPage(&tree->pager, newPid, true);
+
+    InternalPage *p = &parent->internal;
+    memmove(p->children + i + 2, p->children + i + 1,
+        (p->h.n - i) * sizeof(uint32_t));
+    memmove(p->keys + i + 1, p->keys + i, (p->h.n - i) * sizeof(int32_t));
+    p->children[i + 1] = newPid;
+    p->keys[i] = separator;
+    p->h.n++;
+}
+
+bool isFull(Page *page) {
+    return page->h.n == (page->h.leaf ? LEAF_MAX : INTERNAL_MAX);
+}
+
+// Function to insert a key, or update its value if it is
+// already there. Full nodes are split on the way down so a
+// split never has to go back up
+void insert(DiskBTree *tree, int key, int value) {
+    Pager *pager = &tree->pager;
+    uint32_t pid = rootPage(tree);
+    Page *page = getPage(pager, pid);
+    bool dirty = false;
+
+    if (isFull(page)) {
+        uint32_t newRoot = allocPage(tree);
+        Page *rootNode = getPage(pager, newRoot);
+        rootNode->h.leaf = 0;
+        rootNode->h.n = 0;
+        rootNode->internal.children[0] = pid;
+        splitChild(tree, rootNode, 0, page);
+        putPage(pager, pid, true);
+
+        Page *metaPage = getPage(pager, 0);
+        metaPage->meta.root = newRoot;
+        putPage(pager, 0, true);
+        pid = newRoot;
+        page = rootNode;
+        dirty = true;
+    }
+
+    while (!page->h.leaf) {
+        int i = findChild(page->internal.keys, page->h.n, key);
+        uint32_t childPid = page->internal.children[i];
+        Page *child = getPage(pager, childPid);
+        if (isFull(child)) {
+            splitChild(tree, page, i, child);
+            dirty = true;
+            putPage(pager, childPid, true);
+            if (page->internal.keys[i] <= key)
+                childPid = page->internal.children[i + 1];
+            child = getPage(pager, childPid);
+        }
+        putPage(pager, pid, dirty);
+        pid = childPid;
+        page = child;
+        dirty = false;
+    }
+
+    LeafPage *leaf = &page->leaf;
+    int i = findKey(leaf->keys, leaf->h.n, key);
+    if (i < leaf->h.n && leaf->keys[i] == key) {
+        leaf->values[i] = value;
+        putPage(pager, pid, true);
+        return;
+    }
+    memmove(leaf->keys + i + 1, leaf->keys + i, (leaf->h.n - i) * sizeof(int32_t));
+    memmove(leaf->values + i + 1, leaf->values + i,
+        (leaf->h.n - i) * sizeof(int32_t));
+    leaf->keys[i] = key;
+    leaf->values[i] = value;
+    leaf->h.n++;
+    putPage(pager, pid, true);
+
+    Page *metaPage = getPage(pager, 0);
+    metaPage->meta.numKeys++;
+    putPage(pager, 0, true);
+}
+
+// Function to delete a key. The key is only removed from its
+// leaf, pages are not merged: separators stay valid routers
+// and an emptied leaf is refilled by later inserts
+bool deleteKey(DiskBTree *tree, int key) {
+    uint32_t pid = findLeaf(tree, key);
+    Page *page = getPage(&tree->pager, pid);
+    LeafPage *leaf = &page->leaf;
+    int i = findKey(leaf->keys, leaf->h.n, key);
+    if (i >= leaf->h.n || leaf->keys[i] != key) {
+        putPage(&tree->pager, pid, false);
+        return false;
+    }
+    memmove(leaf->keys + i, leaf->keys + i + 1,
+        (leaf->h.n - i - 1) * sizeof(int32_t));
+    memmove(leaf->values + i, leaf->values + i + 1,
+        (leaf->h.n - i - 1) * sizeof(int32_t));
+    leaf->h.n--;
+    putPage(&tree->pager, pid, true);
+
+    Page *metaPage = getPage(&tree->pager, 0);
+    metaPage->meta.numKeys--;
+    putPage(&tree->pager, 0, true);
+    return true;
+}
+
+// Function to call callback for every key in [lo, hi] in
+// ascending order by following the leaf chain, stops early
+// if callback returns false. Returns the number of keys seen
+int rangeScan(DiskBTree *tree, int lo, int hi,
+    bool (*callback)(int key, int value, void *arg), void *arg) {
+    int count = 0;
+    if (lo > hi)
+        return 0;
+    uint32_t pid = findLeaf(tree, lo);
+    Page *page = getPage(&tree->pager, pid);
+    int i = findKey(page->leaf.keys, page->h.n, lo);
+    for (;;) {
+        for (; i < page->h.n; i++) {
+            if (page->leaf.keys[i] > hi
+                || !(count++, callback(page->leaf.keys[i],
+                        page->leaf.values[i], arg))) {
+                putPage(&tree->pager, pid, false);
+                return count;
+            }
+        }
+        uint32_t next = page->h.next;
+        putPage(&tree->pager, pid, false);
+        if (next == NO_PAGE)
+            return count;
+        pid = next;
+        page = getPage(&tree->pager, pid);
+        i = 0;
+    }
+}
+
+// Function to print and reset the buffer pool counters
+void printPoolStats(DiskBTree *tree) {
+    BufferPool *pool = tree->pager.pool;
+    if (pool == NULL)
+        return;
+    unsigned long long total = pool->hits + pool->misses;
+    printf("  %d frames: %llu hits, %llu misses (%.1f%% hit), "
+           "%llu evictions, %llu write-backs\n",
+        pool->numFrames, pool->hits, pool->misses,
+        total ? 100.0 * pool->hits / total : 0.0, pool->evictions,
+        pool->writeBacks);
+    pool->hits = pool->misses = pool->evictions = pool->writeBacks = 0;
+}
+
+bool printKey(int key, int value, void *arg) {
+    (void)arg;
+    printf("%d:%d ", key, value);
+    return true;
+}
+
+double seconds(struct timespec *start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec)
+        + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Function to time random lookups against an open tree
+void benchmarkLookups(DiskBTree *tree, int numKeys, const char *label) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long long found = 0;
+    unsigned int x = 2463534242u;
+    for (int i = 0; i < 1000000; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        found += search(tree, (int)(x % (2u * numKeys)), NULL);
+    }
+    printf("1M lookups, %s: %.3fs (%lld found)\n", label, seconds(&start),
+        found);
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = argc > 1 ? argv[1] : "bplustree.idx";
+    int poolFrames = argc > 2 ? atoi(argv[2]) : 1024;
+    int numKeys = 2000000;
+    struct timespec start;
+    unlink(path);
+
+    // Build the index through the buffer pool
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    DiskBTree *tree = openBTree(path, poolFrames);
+    if (tree == NULL)
+        return 1;
+    for (int i = 0; i < numKeys; i++) {
+        int key = (int)((i * 2654435761u) % (unsigned)numKeys);
+        insert(tree, key, key * 10);
+    }
+    deleteKey(tree, 17);
+    Page *metaPage = getPage(&tree->pager, 0);
+    printf("Built %llu keys in %u pages: %.3fs\n",
+        (unsigned long long)metaPage->meta.numKeys,
+        metaPage->meta.numPages, seconds(&start));
+    putPage(&tree->pager, 0, false);
+    printPoolStats(tree);
+    closeBTree(tree);
+
+    // A restart only maps the file again
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    tree = openBTree(path, 0);
+    if (tree == NULL)
+        return 1;
+    printf("Reopened: %.6fs\n", seconds(&start));
+
+    int value = 0;
+    printf("Key 16 %s", search(tree, 16, &value) ? "found" : "not found");
+    printf(", value %d\n", value);
+    printf("Key 17 %s\n", search(tree, 17, NULL) ? "found" : "not found");
+    printf("Keys in [10, 20]: ");
+    rangeScan(tree, 10, 20, printKey, NULL);
+    printf("\n");
+    benchmarkLookups(tree, numKeys, "mmap");
+    closeBTree(tree);
+
+    // Same lookups through buffer pools of several sizes
+    for (int frames = 64; frames <= 4096; frames *= 4) {
+        tree = openBTree(path, frames);
+        if (tree == NULL)
+            return 1;
+        char label[32];
+        snprintf(label, sizeof(label), "pool of %d", frames);
+        benchmarkLookups(tree, numKeys, label);
+        printPoolStats(tree);
+        closeBTree(tree);
+    }
+
+    unlink(path);
+    return 0;
+}
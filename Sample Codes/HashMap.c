@@ -2,22 +2,73 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <time.h>
 
-// Linked List node
+// Initial capacity, must be a power of two so the
+// bucket index can be taken with a mask
+#define INITIAL_CAPACITY 16
+
+// Grow when numOfElements / capacity goes above
+// MAX_LOAD_NUM / MAX_LOAD_DEN (0.75)
+#define MAX_LOAD_NUM 3
+#define MAX_LOAD_DEN 4
+
+// Number of leading key bytes kept inside the node
+#define KEY_PREFIX 8
+
+// Size of one block of the string arena
+#define ARENA_BLOCK_SIZE (1 << 20)
+
+// The arena is compacted once more than half of it, and
+// more than this many bytes, belong to deleted entries
+#define MIN_DEAD_BYTES 4096
+
+// Number of lookups searchBatch() keeps in flight
+#define BATCH_GROUP 16
+
+// Value search() and searchBatch() give for a missing key
+#define NOT_FOUND "Oops! No data found.\n"
+
+// Linked List node, 32 bytes so two fit in a cache line
 struct node {
 
-    // key is string
-    char *key;
+    // full hash of the key, compared before anything else
+    uint32_t hash;
+
+    // length of the key in bytes
+    uint32_t keyLen;
+
+    // first KEY_PREFIX bytes of the key, zero padded,
+    // keys this short never leave the node
+    char prefix[KEY_PREFIX];
 
-    // value is also string
-    char *value;
+    // key and value copied next to each other in the
+    // arena as "key\0value\0"
+    char *key;
     struct node *next;
 };
 
+// One block of the string arena
+struct arenaBlock {
+    struct arenaBlock *next;
+    size_t used, size;
+    char data[];
+};
+
+// Value is stored right after the key
+char *nodeValue(struct node *node) {
+    return node->key + node->keyLen + 1;
+}
+
 // like constructor
-void setNode(struct node *node, char *key, char *value) {
-    node->key = key;
-    node->value = value;
+void setNode(struct node *node, uint32_t hash, char *key,
+    uint32_t keyLen, char *data) {
+    node->hash = hash;
+    node->keyLen = keyLen;
+    memset(node->prefix, 0, KEY_PREFIX);
+    memcpy(node->prefix, key,
+        keyLen < KEY_PREFIX ? keyLen : KEY_PREFIX);
+    node->key = data;
     node->next = NULL;
     return;
 };
@@ -25,62 +76,206 @@ void setNode(struct node *node, char *key, char *value) {
 struct hashMap {
 
     // Current number of elements in hashMap
-    // and capacity of hashMap
+    // and capacity of hashMap (always a power of two)
     int numOfElements, capacity;
 
+    // capacity - 1, used to turn a hash into a bucket index
+    unsigned int mask;
+
     // hold base address array of linked list
     struct node **arr;
+
+    // owns every key and value stored in the map
+    struct arenaBlock *arena;
+
+    // bytes copied into the arena, and how many of them
+    // belong to deleted entries
+    size_t arenaBytes, deadBytes;
 };
 
 // like constructor
 void initializeHashMap(struct hashMap *mp) {
 
     // Default capacity in this case
-    mp->capacity = 100;
+    mp->capacity = INITIAL_CAPACITY;
+    mp->mask = mp->capacity - 1;
     mp->numOfElements = 0;
+    mp->arena = NULL;
+    mp->arenaBytes = mp->deadBytes = 0;
 
-    // array of size = 1
-    mp->arr = (struct node **)malloc(sizeof(struct node *)
-        * mp->capacity);
+    // every bucket starts as an empty list
+    mp->arr = (struct node **)calloc(mp->capacity,
+        sizeof(struct node *));
     return;
 }
 
+// Copies key and value into the arena and returns
+// where the key starts
+char *arenaCopy(struct hashMap *mp, char *key, size_t keyLen,
+    char *value, size_t valueLen) {
+    size_t need = keyLen + valueLen + 2;
+    struct arenaBlock *block = mp->arena;
+
+    // Start a new block when the current one is full,
+    // oversized pairs get a block of their own
+    if (block == NULL || block->size - block->used < need) {
+        size_t size = need > ARENA_BLOCK_SIZE ? need
+                                              : ARENA_BLOCK_SIZE;
+        block = (struct arenaBlock *)malloc(
+            sizeof(struct arenaBlock) + size);
+        if (block == NULL) {
+            return NULL;
+        }
+        block->size = size;
+        block->used = 0;
+        block->next = mp->arena;
+        mp->arena = block;
+    }
+
+    char *data = block->data + block->used;
+    memcpy(data, key, keyLen + 1);
+    memcpy(data + keyLen + 1, value, valueLen + 1);
+    block->used += need;
+    mp->arenaBytes += need;
+    return data;
+}
+
+// Copies every live key and value into one fresh block
+// and frees the old ones, dropping the bytes of deleted
+// entries. If the block cannot be allocated the old
+// arena is kept
+void compactArena(struct hashMap *mp) {
+    size_t live = mp->arenaBytes - mp->deadBytes;
+    struct arenaBlock *block = (struct arenaBlock *)malloc(
+        sizeof(struct arenaBlock) + live);
+    if (block == NULL) {
+        return;
+    }
+    block->size = live;
+    block->used = 0;
+    block->next = NULL;
+    for (int i = 0; i < mp->capacity; i++) {
+        for (struct node *currNode = mp->arr[i]; currNode != NULL;
+             currNode = currNode->next) {
+            size_t need = currNode->keyLen + 1
+                + strlen(nodeValue(currNode)) + 1;
+            char *data = block->data + block->used;
+            memcpy(data, currNode->key, need);
+            currNode->key = data;
+            block->used += need;
+        }
+    }
+    while (mp->arena != NULL) {
+        struct arenaBlock *next = mp->arena->next;
+        free(mp->arena);
+        mp->arena = next;
+    }
+    mp->arena = block;
+    mp->arenaBytes = live;
+    mp->deadBytes = 0;
+    return;
+}
+
+// Hash of the whole key, independent of capacity so
+// that it can be reused when the table grows
+uint32_t hashString(char *key, uint32_t *keyLen) {
+    uint32_t hash = 0;
+    char *start = key;
+    for (; *key != '\0'; key++) {
+
+        // hash = hash * primeNumber + ascii value
+        hash = hash * 31 + (unsigned char)*key;
+    }
+    *keyLen = (uint32_t)(key - start);
+
+    // Mix the high bits down, the mask only
+    // looks at the low bits
+    hash ^= hash >> 16;
+    hash *= 0x45d9f3bU;
+    hash ^= hash >> 16;
+    return hash;
+}
+
 int hashFunction(struct hashMap *mp, char *key) {
-    int bucketIndex;
-    int sum = 0, factor = 31;
-    for (int i = 0; i < strlen(key); i++) {
-
-        // sum = sum + (ascii value of
-        // char * (primeNumber ^ x))...
-        // where x = 1, 2, 3....n
-        sum = ((sum % mp->capacity)
-            + (((int)key[i]) * factor) % mp->capacity)
-            % mp->capacity;
-
-        // factor = factor * prime
-        // number....(prime
-        // number) ^ x
-        factor = ((factor % INT16_MAX)
-            * (31 % INT16_MAX))
-            % INT16_MAX;
-    }
-
-    bucketIndex = sum;
-    return bucketIndex;
+    uint32_t keyLen;
+    return (int)(hashString(key, &keyLen) & mp->mask);
+}
+
+// Compares hash, length and prefix stored in the node
+// and only then the key bytes in the arena
+int nodeMatches(struct node *node, uint32_t hash, char *key,
+    uint32_t keyLen) {
+    if (node->hash != hash || node->keyLen != keyLen) {
+        return 0;
+    }
+    if (keyLen <= KEY_PREFIX) {
+        return memcmp(node->prefix, key, keyLen) == 0;
+    }
+    return memcmp(node->prefix, key, KEY_PREFIX) == 0
+        && memcmp(node->key + KEY_PREFIX, key + KEY_PREFIX,
+               keyLen - KEY_PREFIX)
+        == 0;
+}
+
+// Doubles the capacity and moves every node into
+// its new bucket, nodes themselves are reused
+void resizeHashMap(struct hashMap *mp) {
+    int newCapacity = mp->capacity * 2;
+    struct node **newArr = (struct node **)calloc(newCapacity,
+        sizeof(struct node *));
+    if (newArr == NULL) {
+
+        // Keep working with longer chains
+        return;
+    }
+
+    mp->capacity = newCapacity;
+    mp->mask = newCapacity - 1;
+    for (int i = 0; i < newCapacity / 2; i++) {
+        struct node *currNode = mp->arr[i];
+        while (currNode != NULL) {
+            struct node *nextNode = currNode->next;
+
+            // Stored hash, no need to touch the key
+            int bucketIndex = currNode->hash & mp->mask;
+            currNode->next = newArr[bucketIndex];
+            newArr[bucketIndex] = currNode;
+            currNode = nextNode;
+        }
+    }
+    free(mp->arr);
+    mp->arr = newArr;
+    return;
 }
 
 void insert(struct hashMap *mp, char *key, char *value) {
 
+    // Grow before the load factor is exceeded
+    if ((long long)(mp->numOfElements + 1) * MAX_LOAD_DEN
+        > (long long)mp->capacity * MAX_LOAD_NUM) {
+        resizeHashMap(mp);
+    }
+
     // Getting bucket index for the given
     // key - value pair
-    int bucketIndex = hashFunction(mp, key);
+    uint32_t keyLen;
+    uint32_t hash = hashString(key, &keyLen);
+    int bucketIndex = hash & mp->mask;
+
+    // Key and value are copied, the caller keeps
+    // ownership of its strings
+    char *data = arenaCopy(mp, key, keyLen, value, strlen(value));
     struct node *newNode = (struct node *)malloc(
 
         // Creating a new node
         sizeof(struct node));
+    if (data == NULL || newNode == NULL) {
+        free(newNode);
+        return;
+    }
 
     // Setting value of node
-    setNode(newNode, key, value);
+    setNode(newNode, hash, key, keyLen, data);
 
     // Bucket index is empty....no collision
     if (mp->arr[bucketIndex] == NULL) {
@@ -97,6 +292,7 @@ void insert(struct hashMap *mp, char *key, char *value) {
         newNode->next = mp->arr[bucketIndex];
         mp->arr[bucketIndex] = newNode;
     }
+    mp->numOfElements++;
     return;
 }
 
@@ -104,7 +300,9 @@ void delete (struct hashMap *mp, char *key) {
 
     // Getting bucket index for the
     // given key
-    int bucketIndex = hashFunction(mp, key);
+    uint32_t keyLen;
+    uint32_t hash = hashString(key, &keyLen);
+    int bucketIndex = hash & mp->mask;
 
     struct node *prevNode = NULL;
 
@@ -117,7 +315,7 @@ void delete (struct hashMap *mp, char *key) {
 
         // Key is matched at delete this
         // node from linked list
-        if (strcmp(key, currNode->key) == 0) {
+        if (nodeMatches(currNode, hash, key, keyLen)) {
 
             // Head node
             // deletion
@@ -129,12 +327,22 @@ void delete (struct hashMap *mp, char *key) {
             else {
                 prevNode->next = currNode->next;
             }
+            mp->deadBytes += keyLen + 1
+                + strlen(nodeValue(currNode)) + 1;
             free(currNode);
+            mp->numOfElements--;
             break;
         }
         prevNode = currNode;
         currNode = currNode->next;
     }
+
+    // Give the space of deleted entries back once
+    // most of the arena is dead
+    if (mp->deadBytes > MIN_DEAD_BYTES
+        && mp->deadBytes > mp->arenaBytes / 2) {
+        compactArena(mp);
+    }
     return;
 }
 
@@ -142,7 +350,9 @@ char *search(struct hashMap *mp, char *key) {
 
     // Getting the bucket index
     // for the given key
-    int bucketIndex = hashFunction(mp, key);
+    uint32_t keyLen;
+    uint32_t hash = hashString(key, &keyLen);
+    int bucketIndex = hash & mp->mask;
 
     // Head of the linked list
     // present at bucket index
@@ -150,17 +360,95 @@ char *search(struct hashMap *mp, char *key) {
     while (bucketHead != NULL) {
 
         // Key is found in the hashMap
-        if (bucketHead->key == key) {
-            return bucketHead->value;
+        if (nodeMatches(bucketHead, hash, key, keyLen)) {
+            return nodeValue(bucketHead);
         }
         bucketHead = bucketHead->next;
     }
 
     // If no key found in the hashMap
     // equal to the given key
-    char *errorMssg = (char *)malloc(sizeof(char) * 25);
-    errorMssg = "Oops! No data found.\n";
-    return errorMssg;
+    return NOT_FOUND;
+}
+
+// Values returned by search() and searchBatch() point into
+// the arena, they stay valid until the next delete(),
+// which may compact it
+
+// Looks up n keys at once, results[i] gets the value of
+// keys[i] or NOT_FOUND, like search(). Keys are handled in
+// groups: every key of a group is hashed and its bucket
+// prefetched, then the chains are walked one node per key
+// per round so that the cache misses of the whole group
+// overlap
+void searchBatch(struct hashMap *mp, char *keys[], int n,
+    char *results[]) {
+    uint32_t hash[BATCH_GROUP], keyLen[BATCH_GROUP];
+    struct node *curr[BATCH_GROUP];
+
+    for (int base = 0; base < n; base += BATCH_GROUP) {
+        int count = n - base < BATCH_GROUP ? n - base : BATCH_GROUP;
+
+        // Stage 1: hash every key, prefetch its bucket slot
+        for (int i = 0; i < count; i++) {
+            hash[i] = hashString(keys[base + i], &keyLen[i]);
+            __builtin_prefetch(&mp->arr[hash[i] & mp->mask]);
+        }
+
+        // Stage 2: read the bucket heads, prefetch the nodes
+        for (int i = 0; i < count; i++) {
+            curr[i] = mp->arr[hash[i] & mp->mask];
+            results[base + i] = NOT_FOUND;
+            if (curr[i] != NULL) {
+                __builtin_prefetch(curr[i]);
+            }
+        }
+
+        // Stage 3: advance every unfinished chain by one node
+        int pending = count;
+        while (pending > 0) {
+            pending = 0;
+            for (int i = 0; i < count; i++) {
+                struct node *node = curr[i];
+                if (node == NULL) {
+                    continue;
+                }
+                if (nodeMatches(node, hash[i], keys[base + i],
+                        keyLen[i])) {
+                    results[base + i] = nodeValue(node);
+                    curr[i] = NULL;
+                    continue;
+                }
+                curr[i] = node->next;
+                if (curr[i] != NULL) {
+                    __builtin_prefetch(curr[i]);
+                    pending++;
+                }
+            }
+        }
+    }
+    return;
+}
+
+// like destructor, frees nodes, buckets and the arena
+void freeHashMap(struct hashMap *mp) {
+    for (int i = 0; i < mp->capacity; i++) {
+        struct node *currNode = mp->arr[i];
+        while (currNode != NULL) {
+            struct node *nextNode = currNode->next;
+            free(currNode);
+            currNode = nextNode;
+        }
+    }
+    free(mp->arr);
+    while (mp->arena != NULL) {
+        struct arenaBlock *next = mp->arena->next;
+        free(mp->arena);
+        mp->arena = next;
+    }
+    mp->arr = NULL;
+    mp->numOfElements = mp->capacity = 0;
+    return;
 }
 
 // Drivers code
@@ -192,5 +480,54 @@ int main() {
     delete (mp, "decentBoy");
     printf("%s\n", search(mp, "decentBoy"));
 
+    // Table grows with the number of elements, keys are
+    // copied so one buffer can be reused
+    char key[16];
+    for (int i = 0; i < 100000; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        insert(mp, key, key);
+    }
+    printf("\nElements : %d, capacity : %d\n",
+        mp->numOfElements, mp->capacity);
+    printf("%s\n", search(mp, "key12345"));
+
+    // One at a time against batched lookups of the same keys
+    int numKeys = 100000;
+    char **keys = (char **)malloc(sizeof(char *) * numKeys);
+    char **results = (char **)malloc(sizeof(char *) * numKeys);
+    for (int i = 0; i < numKeys; i++) {
+        keys[i] = (char *)malloc(16);
+        snprintf(keys[i], 16, "key%d", (i * 7919) % numKeys);
+    }
+    clock_t start = clock();
+    for (int i = 0; i < numKeys; i++) {
+        results[i] = search(mp, keys[i]);
+    }
+    double single = (double)(clock() - start) / CLOCKS_PER_SEC;
+    start = clock();
+    searchBatch(mp, keys, numKeys, results);
+    double batch = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("search : %.4fs, searchBatch : %.4fs, %s\n", single, batch,
+        results[numKeys - 1]);
+    for (int i = 0; i < numKeys; i++) {
+        free(keys[i]);
+    }
+    free(keys);
+    free(results);
+
+    // Deleting and re-inserting the same keys reuses the
+    // arena instead of growing it
+    for (int round = 0; round < 10; round++) {
+        for (int i = 0; i < 100000; i++) {
+            snprintf(key, sizeof(key), "key%d", i);
+            delete (mp, key);
+            insert(mp, key, key);
+        }
+    }
+    printf("Arena after churn : %zu bytes (%zu dead)\n",
+        mp->arenaBytes, mp->deadBytes);
+
+    freeHashMap(mp);
+    free(mp);
     return 0;
 }
\ No newline at end of file
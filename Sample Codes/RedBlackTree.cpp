@@ -1,78 +1,190 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <queue>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
 using namespace std;
 
 enum COLOR { RED, BLACK };
 
-class Node {
+template <class Key, class Value> class Node {
 public:
-    int val;
-    COLOR color;
-    Node *left, *right, *parent;
-
-    Node(int val) : val(val) {
-        parent = left = right = NULL;
-
+    Node *left, *right;
+    // Parent pointer with the color in its low bit, nodes are
+    // pointer-aligned so the bit is always free
+    uintptr_t parentAndColor;
+    Key key;
+    Value value;
+
+    template <class... Args>
+    Node(const Key &key, Args &&...args)
+        : left(NULL), right(NULL), parentAndColor(0), key(key),
+          value(std::forward<Args>(args)...) {
         // Node is created during insertion
         // Node is red at insertion
-        color = RED;
+        setColor(RED);
+    }
+
+    Node *parent() {
+        return reinterpret_cast<Node *>(parentAndColor & ~uintptr_t(1));
+    }
+
+    void setParent(Node *p) {
+        parentAndColor = reinterpret_cast<uintptr_t>(p) | (parentAndColor & 1);
+    }
+
+    COLOR color() { return COLOR(parentAndColor & 1); }
+
+    void setColor(COLOR c) {
+        parentAndColor = (parentAndColor & ~uintptr_t(1)) | c;
     }
 
     // returns pointer to uncle
     Node *uncle() {
         // If no parent or grandparent, then no uncle
-        if (parent == NULL || parent->parent == NULL)
+        if (parent() == NULL || parent()->parent() == NULL)
             return NULL;
 
-        if (parent->isOnLeft())
+        if (parent()->isOnLeft())
             // uncle on right
-            return parent->parent->right;
+            return parent()->parent()->right;
         else
             // uncle on left
-            return parent->parent->left;
+            return parent()->parent()->left;
     }
 
     // check if node is left child of parent
-    bool isOnLeft() { return this == parent->left; }
+    bool isOnLeft() { return this == parent()->left; }
 
     // returns pointer to sibling
     Node *sibling() {
         // sibling null if no parent
-        if (parent == NULL)
+        if (parent() == NULL)
             return NULL;
 
         if (isOnLeft())
-            return parent->right;
+            return parent()->right;
 
-        return parent->left;
+        return parent()->left;
     }
 
     // moves node down and moves given node in its place
     void moveDown(Node *nParent) {
-        if (parent != NULL) {
+        if (parent() != NULL) {
             if (isOnLeft()) {
-                parent->left = nParent;
+                parent()->left = nParent;
             } else {
-                parent->right = nParent;
+                parent()->right = nParent;
             }
         }
-        nParent->parent = parent;
-        parent = nParent;
+        nParent->setParent(parent());
+        setParent(nParent);
     }
 
     bool hasRedChild() {
-        return (left != NULL && left->color == RED) ||
-            (right != NULL && right->color == RED);
+        return (left != NULL && left->color() == RED) ||
+            (right != NULL && right->color() == RED);
     }
 };
 
+// Fixed-size allocator for tree nodes. Nodes are carved out
+// of blocks of NODES_PER_BLOCK taken from Alloc (rebound to
+// T), freed nodes go on a free list and are reused first.
+// Blocks are only returned when the pool is destroyed
+template <class T, class Alloc> class NodePool {
+    typedef typename allocator_traits<Alloc>::template rebind_alloc<T>
+        BlockAlloc;
+    typedef allocator_traits<BlockAlloc> Traits;
+
+    static const size_t NODES_PER_BLOCK = 256;
+
+    // A free node, linked through its own storage
+    struct FreeNode {
+        FreeNode *next;
+    };
+
+    BlockAlloc alloc;
+    vector<T *> blocks;
+    FreeNode *freeList;
+    // Unused part of the newest block
+    T *nextFree;
+    size_t leftInBlock;
+
+public:
+    explicit NodePool(const Alloc &a = Alloc())
+        : alloc(a), freeList(NULL), nextFree(NULL), leftInBlock(0) {}
+
+    NodePool(const NodePool &) = delete;
+    NodePool &operator=(const NodePool &) = delete;
+
+    ~NodePool() {
+        for (T *block : blocks)
+            Traits::deallocate(alloc, block, NODES_PER_BLOCK);
+    }
+
+    // allocates a node and constructs it from args
+    template <class... Args> T *create(Args &&...args) {
+        T *p;
+        if (freeList != NULL) {
+            p = reinterpret_cast<T *>(freeList);
+            freeList = freeList->next;
+        } else {
+            if (leftInBlock == 0) {
+                nextFree = Traits::allocate(alloc, NODES_PER_BLOCK);
+                blocks.push_back(nextFree);
+                leftInBlock = NODES_PER_BLOCK;
+            }
+            p = nextFree++;
+            leftInBlock--;
+        }
+        Traits::construct(alloc, p, std::forward<Args>(args)...);
+        return p;
+    }
+
+    // destroys a node and puts it on the free list
+    void destroy(T *p) {
+        Traits::destroy(alloc, p);
+        FreeNode *f = reinterpret_cast<FreeNode *>(p);
+        f->next = freeList;
+        freeList = f;
+    }
+};
+
+template <class Key, class Value, class Compare = less<Key>,
+    class Alloc = allocator<pair<const Key, Value>>>
 class RBTree {
-    Node *root;
+public:
+    typedef Node<Key, Value> NodeType;
+
+private:
+    NodeType *root;
+    // Node with the largest key, NULL when not known (it is
+    // dropped when that node is deleted and found again when
+    // needed)
+    NodeType *rightmost;
+    Compare comp;
+    NodePool<NodeType, Alloc> pool;
+
+    // true if a and b are equivalent under comp
+    bool equal(const Key &a, const Key &b) {
+        return !comp(a, b) && !comp(b, a);
+    }
 
     // left rotates the given node
-    void leftRotate(Node *x) {
+    void leftRotate(NodeType *x) {
         // new parent will be node's right child
-        Node *nParent = x->right;
+        NodeType *nParent = x->right;
 
         // update root if current node is root
         if (x == root)
@@ -85,15 +197,15 @@ class RBTree {
         // connect new parent's left element with node
         // if it is not null
         if (nParent->left != NULL)
-            nParent->left->parent = x;
+            nParent->left->setParent(x);
 
         // connect new parent with x
         nParent->left = x;
     }
 
-    void rightRotate(Node *x) {
+    void rightRotate(NodeType *x) {
         // new parent will be node's left child
-        Node *nParent = x->left;
+        NodeType *nParent = x->left;
 
         // update root if current node is root
         if (x == root)
@@ -106,44 +218,75 @@ class RBTree {
         // connect new parent's right element with node
         // if it is not null
         if (nParent->right != NULL)
-            nParent->right->parent = x;
+            nParent->right->setParent(x);
 
         // connect new parent with x
         nParent->right = x;
     }
 
-    void swapColors(Node *x1, Node *x2) {
+    void swapColors(NodeType *x1, NodeType *x2) {
         COLOR temp;
-        temp = x1->color;
-        x1->color = x2->color;
-        x2->color = temp;
+        temp = x1->color();
+        x1->setColor(x2->color());
+        x2->setColor(temp);
     }
 
-    void swapValues(Node *u, Node *v) {
-        int temp;
-        temp = u->val;
-        u->val = v->val;
-        v->val = temp;
+    // swaps the places of v and its in-order successor u in
+    // the tree, colors included. Nodes keep their keys and
+    // values, so pointers to u stay valid. u has no left child
+    void swapWithSuccessor(NodeType *v, NodeType *u) {
+        NodeType *vParent = v->parent(), *uParent = u->parent();
+        NodeType *uRight = u->right;
+        COLOR vColor = v->color(), uColor = u->color();
+
+        // u takes v's place under v's parent
+        if (vParent == NULL)
+            root = u;
+        else if (v->isOnLeft())
+            vParent->left = u;
+        else
+            vParent->right = u;
+        u->setParent(vParent);
+        u->left = v->left;
+        u->left->setParent(u);
+
+        // v takes u's place, right below u if u was its child
+        if (uParent == v) {
+            u->right = v;
+            v->setParent(u);
+        } else {
+            u->right = v->right;
+            u->right->setParent(u);
+            uParent->left = v;
+            v->setParent(uParent);
+        }
+        v->left = NULL;
+        v->right = uRight;
+        if (uRight != NULL)
+            uRight->setParent(v);
+
+        u->setColor(vColor);
+        v->setColor(uColor);
     }
 
     // fix red red at given node
-    void fixRedRed(Node *x) {
+    void fixRedRed(NodeType *x) {
         // if x is root color it black and return
         if (x == root) {
-            x->color = BLACK;
+            x->setColor(BLACK);
             return;
         }
 
         // initialize parent, grandparent, uncle
-        Node *parent = x->parent, *grandparent = parent->parent,
+        NodeType *parent = x->parent(), *grandparent = parent->parent(),
             *uncle = x->uncle();
 
-        if (parent->color != BLACK) {
-            if (uncle != NULL && uncle->color == RED) {
+        if (parent->color() != BLACK) {
+            if (uncle != NULL && uncle->color() == RED) {
                 // uncle red, perform recoloring and recurse
-                parent->color = BLACK;
-                uncle->color = BLACK;
-                grandparent->color = RED;
+                parent->setColor(BLACK);
+                uncle->setColor(BLACK);
+                grandparent->setColor(RED);
                 fixRedRed(grandparent);
             } else {
                 // Else perform LR, LL, RL, RR
@@ -175,8 +318,8 @@ class RBTree {
 
     // find node that do not have a left child
     // in the subtree of the given node
-    Node *successor(Node *x) {
-        Node *temp = x;
+    NodeType *successor(NodeType *x) {
+        NodeType *temp = x;
 
         while (temp->left != NULL)
             temp = temp->left;
@@ -185,7 +328,7 @@ class RBTree {
     }
 
     // find node that replaces a deleted node in BST
-    Node *BSTreplace(Node *x) {
+    NodeType *BSTreplace(NodeType *x) {
         // when node have 2 children
         if (x->left != NULL && x->right != NULL)
             return successor(x->right);
@@ -202,12 +345,12 @@ class RBTree {
     }
 
     // deletes the given node
-    void deleteNode(Node *v) {
-        Node *u = BSTreplace(v);
+    void deleteNode(NodeType *v) {
+        NodeType *u = BSTreplace(v);
 
         // True when u and v are both black
-        bool uvBlack = ((u == NULL || u->color == BLACK) && (v->color == BLACK));
-        Node *parent = v->parent;
+        bool uvBlack = ((u == NULL || u->color() == BLACK) && (v->color() == BLACK));
+        NodeType *parent = v->parent();
 
         if (u == NULL) {
             // u is NULL therefore v is leaf
@@ -223,7 +366,7 @@ class RBTree {
                     // u or v is red
                     if (v->sibling() != NULL)
                         // sibling is not null, make it red"
-                        v->sibling()->color = RED;
+                        v->sibling()->setColor(RED);
                 }
 
                 // delete v from the tree
@@ -233,17 +376,19 @@ class RBTree {
                     parent->right = NULL;
                 }
             }
-            delete v;
+            pool.destroy(v);
             return;
         }
 
         if (v->left == NULL || v->right == NULL) {
             // v has 1 child
             if (v == root) {
-                // v is root, assign the value of u to v, and delete u
-                v->val = u->val;
-                v->left = v->right = NULL;
-                delete u;
+                // v is root, its only child u is a red leaf and
+                // becomes the root
+                root = u;
+                u->setParent(NULL);
+                u->setColor(BLACK);
+                pool.destroy(v);
             } else {
                 // Detach v from tree and move u up
                 if (v->isOnLeft()) {
@@ -251,38 +396,39 @@ class RBTree {
                 } else {
                     parent->right = u;
                 }
-                delete v;
-                u->parent = parent;
+                pool.destroy(v);
+                u->setParent(parent);
                 if (uvBlack) {
                     // u and v both black, fix double black at u
                     fixDoubleBlack(u);
                 } else {
                     // u or v red, color u black
-                    u->color = BLACK;
+                    u->setColor(BLACK);
                 }
             }
             return;
         }
 
-        // v has 2 children, swap values with successor and recurse
-        swapValues(u, v);
-        deleteNode(u);
+        // v has 2 children, move it to its successor's place
+        // and recurse, it has at most a right child there
+        swapWithSuccessor(v, u);
+        deleteNode(v);
     }
 
-    void fixDoubleBlack(Node *x) {
+    void fixDoubleBlack(NodeType *x) {
         if (x == root)
             // Reached root
             return;
 
-        Node *sibling = x->sibling(), *parent = x->parent;
+        NodeType *sibling = x->sibling(), *parent = x->parent();
         if (sibling == NULL) {
             // No sibling, double black pushed up
             fixDoubleBlack(parent);
         } else {
-            if (sibling->color == RED) {
+            if (sibling->color() == RED) {
                 // Sibling red
-                parent->color = RED;
-                sibling->color = BLACK;
+                parent->setColor(RED);
+                sibling->setColor(BLACK);
                 if (sibling->isOnLeft()) {
                     // left case
                     rightRotate(parent);
@@ -295,53 +441,53 @@ class RBTree {
                 // Sibling black
                 if (sibling->hasRedChild()) {
                     // at least 1 red children
-                    if (sibling->left != NULL && sibling->left->color == RED) {
+                    if (sibling->left != NULL && sibling->left->color() == RED) {
                         if (sibling->isOnLeft()) {
                             // left left
-                            sibling->left->color = sibling->color;
-                            sibling->color = parent->color;
+                            sibling->left->setColor(sibling->color());
+                            sibling->setColor(parent->color());
                             rightRotate(parent);
                         } else {
                             // right left
-                            sibling->left->color = parent->color;
+                            sibling->left->setColor(parent->color());
                             rightRotate(sibling);
                             leftRotate(parent);
                         }
                     } else {
                         if (sibling->isOnLeft()) {
                             // left right
-                            sibling->right->color = parent->color;
+                            sibling->right->setColor(parent->color());
                             leftRotate(sibling);
                             rightRotate(parent);
                         } else {
                             // right right
-                            sibling->right->color = sibling->color;
-                            sibling->color = parent->color;
+                            sibling->right->setColor(sibling->color());
+                            sibling->setColor(parent->color());
                             leftRotate(parent);
                         }
                     }
-                    parent->color = BLACK;
+                    parent->setColor(BLACK);
                 } else {
                     // 2 black children
-                    sibling->color = RED;
-                    if (parent->color == BLACK)
+                    sibling->setColor(RED);
+                    if (parent->color() == BLACK)
                         fixDoubleBlack(parent);
                     else
-                        parent->color = BLACK;
+                        parent->setColor(BLACK);
                 }
             }
         }
     }
 
     // prints level order for given node
-    void levelOrder(Node *x) {
+    void levelOrder(NodeType *x) {
         if (x == NULL)
             // return if node is null
             return;
 
         // queue for level order
-        queue<Node *> q;
-        Node *curr;
+        queue<NodeType *> q;
+        NodeType *curr;
 
         // push x
         q.push(x);
@@ -353,7 +499,7 @@ class RBTree {
             q.pop();
 
             // print node value
-            cout << curr->val << " ";
+            cout << curr->key << " ";
 
             // push children to queue
             if (curr->left != NULL)
@@ -363,34 +509,223 @@ class RBTree {
         }
     }
 
+    // finds the node holding key, or returns NULL and sets
+    // parent and left to where a new node for key would hang
+    // (parent is NULL for an empty tree)
+    NodeType *findSlot(const Key &key, NodeType *&parent, bool &left) {
+        NodeType *x = root;
+        parent = NULL;
+        left = false;
+        while (x != NULL) {
+            parent = x;
+            if (comp(key, x->key)) {
+                left = true;
+                x = x->left;
+            } else if (comp(x->key, key)) {
+                left = false;
+                x = x->right;
+            } else {
+                return x;
+            }
+        }
+        return NULL;
+    }
+
+    // creates a node for key under parent and fixes the tree
+    template <class... Args>
+    NodeType *attach(NodeType *parent, bool left, const Key &key,
+        Args &&...args) {
+        NodeType *x = pool.create(key, std::forward<Args>(args)...);
+        if (parent == NULL) {
+            root = x;
+            rightmost = x;
+        } else {
+            x->setParent(parent);
+            if (left) {
+                parent->left = x;
+            } else {
+                parent->right = x;
+                if (parent == rightmost)
+                    rightmost = x;
+            }
+        }
+
+        // fix red red violation if exists
+        fixRedRed(x);
+        return x;
+    }
+
+    // returns the node with the largest key
+    NodeType *maximum() {
+        if (rightmost == NULL && root != NULL) {
+            rightmost = root;
+            while (rightmost->right != NULL)
+                rightmost = rightmost->right;
+        }
+        return rightmost;
+    }
+
+    // returns the in-order predecessor of x
+    NodeType *predecessor(NodeType *x) {
+        if (x->left != NULL) {
+            x = x->left;
+            while (x->right != NULL)
+                x = x->right;
+            return x;
+        }
+        while (x->parent() != NULL && x->isOnLeft())
+            x = x->parent();
+        return x->parent();
+    }
+
+    // returns the in-order successor of x
+    NodeType *nextNode(NodeType *x) {
+        if (x->right != NULL) {
+            x = x->right;
+            while (x->left != NULL)
+                x = x->left;
+            return x;
+        }
+        while (x->parent() != NULL && !x->isOnLeft())
+            x = x->parent();
+        return x->parent();
+    }
+
+    // returns the first node whose key is not less than key
+    // (orEqual: greater than key), NULL if there is none
+    NodeType *bound(const Key &key, bool orEqual) {
+        NodeType *x = root, *result = NULL;
+        while (x != NULL) {
+            if (orEqual ? comp(key, x->key) : !comp(x->key, key)) {
+                result = x;
+                x = x->left;
+            } else {
+                x = x->right;
+            }
+        }
+        return result;
+    }
+
+    // returns every node of a subtree to the pool
+    void destroyTree(NodeType *x) {
+        if (x == NULL)
+            return;
+        destroyTree(x->left);
+        destroyTree(x->right);
+        pool.destroy(x);
+    }
+
     // prints inorder recursively
-    void inorder(Node *x) {
+    void inorder(NodeType *x) {
         if (x == NULL)
             return;
         inorder(x->left);
-        cout << x->val << " ";
+        cout << x->key << " ";
         inorder(x->right);
     }
 
 public:
     // constructor
     // initialize root
-    RBTree() { root = NULL; }
+    RBTree(const Compare &comp = Compare(), const Alloc &alloc = Alloc())
+        : root(NULL), rightmost(NULL), comp(comp), pool(alloc) {}
+
+    RBTree(const RBTree &) = delete;
+    RBTree &operator=(const RBTree &) = delete;
+
+    ~RBTree() { destroyTree(root); }
+
+    NodeType *getRoot() { return root; }
+
+    // Bidirectional in-order iterator. Steps follow parent
+    // pointers, no stack is kept. Nodes never trade keys, so
+    // deleting a key only invalidates iterators to it
+    class iterator {
+        friend class RBTree;
+        NodeType *x;
+        RBTree *tree;
+
+        iterator(NodeType *x, RBTree *tree) : x(x), tree(tree) {}
+
+    public:
+        iterator() : x(NULL), tree(NULL) {}
+
+        NodeType &operator*() const { return *x; }
+        NodeType *operator->() const { return x; }
+
+        // the node, usable as a hint for try_emplace_hint
+        NodeType *node() const { return x; }
+
+        iterator &operator++() {
+            x = tree->nextNode(x);
+            return *this;
+        }
+
+        // decrementing end() gives the largest key
+        iterator &operator--() {
+            x = x == NULL ? tree->maximum() : tree->predecessor(x);
+            return *this;
+        }
+
+        iterator operator++(int) {
+            iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        iterator operator--(int) {
+            iterator old = *this;
+            --*this;
+            return old;
+        }
+
+        bool operator==(const iterator &other) const { return x == other.x; }
+        bool operator!=(const iterator &other) const { return x != other.x; }
+    };
+
+    iterator begin() {
+        NodeType *x = root;
+        while (x != NULL && x->left != NULL)
+            x = x->left;
+        return iterator(x, this);
+    }
+
+    iterator end() { return iterator(NULL, this); }
 
-    Node *getRoot() { return root; }
+    // first key not less than key
+    iterator lower_bound(const Key &key) {
+        return iterator(bound(key, false), this);
+    }
+
+    // first key greater than key
+    iterator upper_bound(const Key &key) {
+        return iterator(bound(key, true), this);
+    }
+
+    // calls fn(key, value) for every key in [lo, hi] in order,
+    // O(log n + k) for k keys. Returns k
+    template <class Fn> size_t rangeVisit(const Key &lo, const Key &hi, Fn fn) {
+        size_t count = 0;
+        for (NodeType *x = bound(lo, false); x != NULL && !comp(hi, x->key);
+             x = nextNode(x)) {
+            fn(x->key, x->value);
+            count++;
+        }
+        return count;
+    }
 
     // searches for given value
     // if found returns the node (used for delete)
     // else returns the last node while traversing (used in insert)
-    Node *search(int n) {
-        Node *temp = root;
+    NodeType *search(const Key &n) {
+        NodeType *temp = root;
         while (temp != NULL) {
-            if (n < temp->val) {
+            if (comp(n, temp->key)) {
                 if (temp->left == NULL)
                     break;
                 else
                     temp = temp->left;
-            } else if (n == temp->val) {
+            } else if (!comp(temp->key, n)) {
                 break;
             } else {
                 if (temp->right == NULL)
@@ -403,54 +738,111 @@ public:
         return temp;
     }
 
-    // inserts the given value to tree
-    void insert(int n) {
-        Node *newNode = new Node(n);
-        if (root == NULL) {
-            // when root is null
-            // simply insert value at root
-            newNode->color = BLACK;
-            root = newNode;
-        } else {
-            Node *temp = search(n);
+    // inserts key with a value constructed from args unless
+    // key is already there. One descent, and the node is only
+    // allocated when it is inserted. Returns the node holding
+    // key and whether it was created
+    template <class... Args>
+    pair<NodeType *, bool> try_emplace(const Key &key, Args &&...args) {
+        NodeType *parent;
+        bool left;
+        NodeType *x = findSlot(key, parent, left);
+        if (x != NULL)
+            return make_pair(x, false);
+        return make_pair(
+            attach(parent, left, key, std::forward<Args>(args)...), true);
+    }
 
-            if (temp->val == n) {
-                // return if value already exists
-                return;
+    // like try_emplace, with a hint: the node key belongs right
+    // before, or NULL if key belongs after every key. A right
+    // hint costs a comparison or two instead of a descent, so
+    // keys inserted in ascending order with a NULL hint take
+    // amortized O(1). A wrong hint falls back to try_emplace
+    template <class... Args>
+    pair<NodeType *, bool> try_emplace_hint(NodeType *hint, const Key &key,
+        Args &&...args) {
+        if (hint == NULL) {
+            NodeType *last = maximum();
+            if (last == NULL || comp(last->key, key))
+                return make_pair(
+                    attach(last, false, key, std::forward<Args>(args)...),
+                    true);
+        } else if (comp(key, hint->key)) {
+            NodeType *prev = predecessor(hint);
+            if (prev == NULL || comp(prev->key, key)) {
+                // hint's left slot is free, or prev is the
+                // largest key under it and has a free right slot
+                if (hint->left == NULL)
+                    return make_pair(
+                        attach(hint, true, key, std::forward<Args>(args)...),
+                        true);
+                return make_pair(
+                    attach(prev, false, key, std::forward<Args>(args)...),
+                    true);
             }
+        } else if (!comp(hint->key, key)) {
+            return make_pair(hint, false);
+        }
+        return try_emplace(key, std::forward<Args>(args)...);
+    }
 
-            // if value is not found, search returns the node
-            // where the value is to be inserted
-
-            // connect new node to correct node
-            newNode->parent = temp;
+    // inserts key with value, or assigns value if key is
+    // already there. Returns the node and whether it was
+    // created
+    template <class M>
+    pair<NodeType *, bool> insert_or_assign(const Key &key, M &&value) {
+        pair<NodeType *, bool> result
+            = try_emplace(key, std::forward<M>(value));
+        if (!result.second)
+            result.first->value = std::forward<M>(value);
+        return result;
+    }
 
-            if (n < temp->val)
-                temp->left = newNode;
-            else
-                temp->right = newNode;
+    template <class M>
+    pair<NodeType *, bool> insert_or_assign_hint(NodeType *hint,
+        const Key &key, M &&value) {
+        pair<NodeType *, bool> result
+            = try_emplace_hint(hint, key, std::forward<M>(value));
+        if (!result.second)
+            result.first->value = std::forward<M>(value);
+        return result;
+    }
 
-            // fix red red violation if exists
-            fixRedRed(newNode);
-        }
+    // inserts the given key and value to tree, nothing is
+    // allocated if the key already exists
+    void insert(const Key &n, const Value &value = Value()) {
+        try_emplace(n, value);
     }
 
     // utility function that deletes the node with given value
-    void deleteByVal(int n) {
+    void deleteByVal(const Key &n) {
         if (root == NULL)
             // Tree is empty
             return;
 
-        Node *v = search(n), *u;
+        NodeType *v = search(n);
 
-        if (v->val != n) {
+        if (!equal(v->key, n)) {
             cout << "No node found to delete with value:" << n << endl;
             return;
         }
 
+        // the largest is found again on the next hinted insert
+        if (v == rightmost)
+            rightmost = NULL;
         deleteNode(v);
     }
 
+    // removes the key pos points to and returns the iterator
+    // after it, other iterators stay valid
+    iterator erase(iterator pos) {
+        NodeType *next = nextNode(pos.x);
+        if (pos.x == rightmost)
+            rightmost = NULL;
+        deleteNode(pos.x);
+        return iterator(next, this);
+    }
+
     // prints inorder of the tree
     void printInOrder() {
         cout << "Inorder: " << endl;
@@ -472,8 +864,552 @@ public:
     }
 };
 
+// Node of PersistentRBTree. There are no parent pointers:
+// a write copies the path it changes, and the nodes of a
+// published version are never written again
+template <class Key, class Value> class PersistentNode {
+public:
+    PersistentNode *left, *right;
+    // Write that created the node. Nodes of the write in
+    // progress are still private and changed in place
+    uint64_t version;
+    COLOR color;
+    Key key;
+    Value value;
+
+    PersistentNode(const Key &key, const Value &value, uint64_t version)
+        : left(NULL), right(NULL), version(version), color(RED), key(key),
+          value(value) {}
+};
+
+// Most threads that may read PersistentRBTrees at once
+const int MAX_READERS = 128;
+
+// Reader slots held by live threads
+atomic<bool> readerSlotUsed[MAX_READERS];
+
+// A thread's claim on a reader slot: the first free one is
+// taken on its first read and given back when it exits, by
+// which time its snapshots are gone and the slot is idle in
+// every tree
+struct ReaderSlotClaim {
+    int slot;
+
+    ReaderSlotClaim() {
+        for (slot = 0; slot < MAX_READERS; slot++) {
+            bool expected = false;
+            if (readerSlotUsed[slot].compare_exchange_strong(expected, true))
+                return;
+        }
+        cerr << "more than " << MAX_READERS << " reader threads" << endl;
+        abort();
+    }
+
+    ~ReaderSlotClaim() { readerSlotUsed[slot].store(false); }
+};
+
+// returns the calling thread's reader slot, the same in
+// every PersistentRBTree
+int readerSlot() {
+    thread_local ReaderSlotClaim claim;
+    return claim.slot;
+}
+
+// Left-leaning red-black tree with path copying. Writers
+// are serialized by a mutex, build the new version next to
+// the old one and publish its root with one atomic store.
+// Readers take no lock: a Snapshot pins the root it loaded
+// and the nodes under it stay valid until it is destroyed.
+// Nodes a write replaced are retired with the epoch of that
+// write and freed once every reader has moved past it
+template <class Key, class Value, class Compare = less<Key>,
+    class Alloc = allocator<pair<const Key, Value>>>
+class PersistentRBTree {
+public:
+    typedef PersistentNode<Key, Value> NodeType;
+
+private:
+    static const uint64_t IDLE = UINT64_MAX;
+
+    // Epoch a reader thread entered in, IDLE when it is not
+    // reading. depth counts nested snapshots of one thread
+    struct alignas(64) ReaderSlot {
+        atomic<uint64_t> epoch;
+        int depth;
+    };
+
+    atomic<NodeType *> root;
+    atomic<uint64_t> epoch;
+    ReaderSlot readers[MAX_READERS];
+
+    // Writer state, guarded by writeLock
+    mutex writeLock;
+    uint64_t version;
+    Compare comp;
+    NodePool<NodeType, Alloc> pool;
+    // Published nodes the write in progress replaced
+    vector<NodeType *> replaced;
+    // Nodes waiting for readers to leave, oldest first
+    deque<pair<uint64_t, NodeType *>> retired;
+
+    bool isRed(NodeType *x) { return x != NULL && x->color == RED; }
+
+    // returns a node of the write in progress for x: x itself
+    // if the write created it, else a copy, and x is replaced
+    NodeType *own(NodeType *x) {
+        if (x->version == version)
+            return x;
+        NodeType *copy = pool.create(*x);
+        copy->version = version;
+        replaced.push_back(x);
+        return copy;
+    }
+
+    // frees a node unlinked by the write in progress
+    void drop(NodeType *x) {
+        if (x->version == version)
+            pool.destroy(x);
+        else
+            replaced.push_back(x);
+    }
+
+    NodeType *rotateLeft(NodeType *h) {
+        NodeType *x = own(h->right);
+        h->right = x->left;
+        x->left = h;
+        x->color = h->color;
+        h->color = RED;
+        return x;
+    }
+
+    NodeType *rotateRight(NodeType *h) {
+        NodeType *x = own(h->left);
+        h->left = x->right;
+        x->right = h;
+        x->color = h->color;
+        h->color = RED;
+        return x;
+    }
+
+    void flipColors(NodeType *h) {
+        h->left = own(h->left);
+        h->right = own(h->right);
+        h->color = h->color == RED ? BLACK : RED;
+        h->left->color = h->left->color == RED ? BLACK : RED;
+        h->right->color = h->right->color == RED ? BLACK : RED;
+    }
+
+    // restores the left-leaning invariants at h
+    NodeType *balance(NodeType *h) {
+        if (isRed(h->right) && !isRed(h->left))
+            h = rotateLeft(h);
+        if (isRed(h->left) && isRed(h->left->left))
+            h = rotateRight(h);
+        if (isRed(h->left) && isRed(h->right))
+            flipColors(h);
+        return h;
+    }
+
+    NodeType *put(NodeType *h, const Key &key, const Value &value) {
+        if (h == NULL)
+            return pool.create(key, value, version);
+        h = own(h);
+        if (comp(key, h->key))
+            h->left = put(h->left, key, value);
+        else if (comp(h->key, key))
+            h->right = put(h->right, key, value);
+        else
+            h->value = value;
+        return balance(h);
+    }
+
+    // makes h->left or one of its children red, h is owned
+    NodeType *moveRedLeft(NodeType *h) {
+        flipColors(h);
+        if (isRed(h->right->left)) {
+            h->right = rotateRight(own(h->right));
+            h = rotateLeft(h);
+            flipColors(h);
+        }
+        return h;
+    }
+
+    // makes h->right or one of its children red, h is owned
+    NodeType *moveRedRight(NodeType *h) {
+        flipColors(h);
+        if (isRed(h->left->left)) {
+            h = rotateRight(h);
+            flipColors(h);
+        }
+        return h;
+    }
+
+    NodeType *removeMin(NodeType *h) {
+        if (h->left == NULL) {
+            drop(h);
+            return NULL;
+        }
+        h = own(h);
+        if (!isRed(h->left) && !isRed(h->left->left))
+            h = moveRedLeft(h);
+        h->left = removeMin(h->left);
+        return balance(h);
+    }
+
+    // removes key, which is in the subtree of h
+    NodeType *remove(NodeType *h, const Key &key) {
+        h = own(h);
+        if (comp(key, h->key)) {
+            if (!isRed(h->left) && !isRed(h->left->left))
+                h = moveRedLeft(h);
+            h->left = remove(h->left, key);
+        } else {
+            if (isRed(h->left))
+                h = rotateRight(h);
+            if (!comp(h->key, key) && h->right == NULL) {
+                drop(h);
+                return NULL;
+            }
+            if (!isRed(h->right) && !isRed(h->right->left))
+                h = moveRedRight(h);
+            if (!comp(h->key, key)) {
+                // take over the smallest key of the right subtree
+                NodeType *x = h->right;
+                while (x->left != NULL)
+                    x = x->left;
+                h->key = x->key;
+                h->value = x->value;
+                h->right = removeMin(h->right);
+            } else {
+                h->right = remove(h->right, key);
+            }
+        }
+        return balance(h);
+    }
+
+    // publishes the new version and retires what it replaced
+    void publish(NodeType *newRoot) {
+        if (newRoot != NULL)
+            newRoot->color = BLACK;
+        root.store(newRoot);
+        uint64_t e = epoch.fetch_add(1);
+        for (NodeType *x : replaced)
+            retired.push_back(make_pair(e, x));
+        replaced.clear();
+        reclaim();
+    }
+
+    // frees the retired nodes no reader can still reach: a
+    // reader that entered after epoch e loaded a root
+    // published after the nodes of e were unlinked
+    void reclaim() {
+        uint64_t oldest = IDLE;
+        for (int i = 0; i < MAX_READERS; i++)
+            oldest = min(oldest, readers[i].epoch.load());
+        while (!retired.empty() && retired.front().first < oldest) {
+            pool.destroy(retired.front().second);
+            retired.pop_front();
+        }
+    }
+
+    void destroyTree(NodeType *x) {
+        if (x == NULL)
+            return;
+        destroyTree(x->left);
+        destroyTree(x->right);
+        pool.destroy(x);
+    }
+
+public:
+    PersistentRBTree(const Compare &comp = Compare(), const Alloc &alloc = Alloc())
+        : root(NULL), epoch(1), version(0), comp(comp), pool(alloc) {
+        for (int i = 0; i < MAX_READERS; i++) {
+            readers[i].epoch.store(IDLE);
+            readers[i].depth = 0;
+        }
+    }
+
+    PersistentRBTree(const PersistentRBTree &) = delete;
+    PersistentRBTree &operator=(const PersistentRBTree &) = delete;
+
+    // no reader may be active any more
+    ~PersistentRBTree() {
+        destroyTree(root.load());
+        for (auto &entry : retired)
+            pool.destroy(entry.second);
+    }
+
+    // A consistent, immutable view of the tree. Lookups on it
+    // never block and never see a later write
+    class Snapshot {
+        PersistentRBTree *tree;
+        ReaderSlot *slot;
+        NodeType *top;
+
+        template <class Fn>
+        void visit(NodeType *x, const Key &lo, const Key &hi, Fn &fn,
+            size_t &count) {
+            while (x != NULL) {
+                if (tree->comp(x->key, lo)) {
+                    x = x->right;
+                } else if (tree->comp(hi, x->key)) {
+                    x = x->left;
+                } else {
+                    visit(x->left, lo, hi, fn, count);
+                    fn(x->key, x->value);
+                    count++;
+                    x = x->right;
+                }
+            }
+        }
+
+    public:
+        explicit Snapshot(PersistentRBTree &tree) : tree(&tree) {
+            slot = &tree.readers[readerSlot()];
+            if (slot->depth++ == 0)
+                slot->epoch.store(tree.epoch.load());
+            top = tree.root.load();
+        }
+
+        Snapshot(const Snapshot &) = delete;
+        Snapshot &operator=(const Snapshot &) = delete;
+
+        ~Snapshot() {
+            if (--slot->depth == 0)
+                slot->epoch.store(IDLE);
+        }
+
+        // returns the node holding key in this snapshot, or NULL
+        const NodeType *find(const Key &key) const {
+            NodeType *x = top;
+            while (x != NULL) {
+                if (tree->comp(key, x->key))
+                    x = x->left;
+                else if (tree->comp(x->key, key))
+                    x = x->right;
+                else
+                    return x;
+            }
+            return NULL;
+        }
+
+        // calls fn(key, value) for every key in [lo, hi] in
+        // order, returns how many there were
+        template <class Fn> size_t rangeVisit(const Key &lo, const Key &hi, Fn fn) {
+            size_t count = 0;
+            visit(top, lo, hi, fn, count);
+            return count;
+        }
+
+        const NodeType *getRoot() const { return top; }
+    };
+
+    // copies the value of key into value, false if key is not
+    // in the tree
+    bool find(const Key &key, Value &value) {
+        Snapshot snapshot(*this);
+        const NodeType *x = snapshot.find(key);
+        if (x == NULL)
+            return false;
+        value = x->value;
+        return true;
+    }
+
+    // inserts key with value, or replaces its value
+    void insert(const Key &key, const Value &value) {
+        lock_guard<mutex> guard(writeLock);
+        version++;
+        publish(put(root.load(), key, value));
+    }
+
+    // deletes key, returns false if it is not in the tree
+    bool erase(const Key &key) {
+        lock_guard<mutex> guard(writeLock);
+        NodeType *h = root.load();
+        NodeType *x = h;
+        while (x != NULL && (comp(key, x->key) || comp(x->key, key)))
+            x = comp(key, x->key) ? x->left : x->right;
+        if (x == NULL)
+            return false;
+
+        version++;
+        h = own(h);
+        if (!isRed(h->left) && !isRed(h->right))
+            h->color = RED;
+        publish(remove(h, key));
+        return true;
+    }
+};
+
+double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start)
+        .count();
+}
+
+// Benchmark: random inserts, lookups and deletes against
+// std::map, which allocates every node on its own
+void benchmark(int numKeys) {
+    // Distinct even keys in random order, odd keys miss
+    vector<int> keys(numKeys);
+    for (int i = 0; i < numKeys; i++)
+        keys[i] = 2 * i;
+    shuffle(keys.begin(), keys.end(), mt19937(42));
+
+    long long found = 0;
+    auto start = chrono::steady_clock::now();
+    {
+        RBTree<int, int> tree;
+        for (int key : keys)
+            tree.insert(key, key);
+        for (int key : keys)
+            found += tree.search(key)->key == key;
+        for (int i = 0; i < numKeys; i += 2)
+            tree.deleteByVal(keys[i]);
+    }
+    double treeTime = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    {
+        map<int, int> tree;
+        for (int key : keys)
+            tree.emplace(key, key);
+        for (int key : keys)
+            found -= tree.count(key);
+        for (int i = 0; i < numKeys; i += 2)
+            tree.erase(keys[i]);
+    }
+    double mapTime = secondsSince(start);
+
+    cout << numKeys << " keys: RBTree<int, int> " << treeTime << "s ("
+         << sizeof(RBTree<int, int>::NodeType) << " bytes/node), std::map "
+         << mapTime << "s (" << found << ")" << endl;
+}
+
+// Benchmark: ingesting keys in ascending order, plain
+// try_emplace against a NULL (end) hint and std::map with an
+// end() hint, then overwriting every value
+void benchmarkSortedIngest(int numKeys) {
+    long long created = 0;
+    RBTree<int, int> plain, hinted;
+    map<int, int> reference;
+
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < numKeys; i++)
+        created += plain.try_emplace(i, i).second;
+    double plainTime = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < numKeys; i++)
+        created += hinted.try_emplace_hint(NULL, i, i).second;
+    double hintTime = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < numKeys; i++)
+        reference.emplace_hint(reference.end(), i, i);
+    double mapTime = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < numKeys; i++)
+        created += hinted.insert_or_assign(i, -i).second;
+    double assignTime = secondsSince(start);
+
+    cout << numKeys << " ascending keys: try_emplace " << plainTime
+         << "s, with hint " << hintTime << "s, std::map hint " << mapTime
+         << "s; insert_or_assign existing " << assignTime << "s ("
+         << created << " created)" << endl;
+}
+
+// Benchmark: window queries over timestamps with rangeVisit
+// against std::map's lower_bound and iteration
+void benchmarkWindows(int numKeys, int window) {
+    RBTree<long long, int> tree;
+    map<long long, int> reference;
+    for (int i = 0; i < numKeys; i++) {
+        tree.try_emplace_hint(NULL, 10LL * i, i);
+        reference.emplace_hint(reference.end(), 10LL * i, i);
+    }
+
+    int queries = 100000;
+    long long sum = 0;
+    auto start = chrono::steady_clock::now();
+    for (int q = 0; q < queries; q++) {
+        long long lo = (q * 2654435761u) % (10u * numKeys);
+        tree.rangeVisit(lo, lo + 10LL * window,
+            [&sum](const long long &, int &value) { sum += value; });
+    }
+    double treeTime = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    for (int q = 0; q < queries; q++) {
+        long long lo = (q * 2654435761u) % (10u * numKeys);
+        for (auto it = reference.lower_bound(lo);
+             it != reference.end() && it->first <= lo + 10LL * window; ++it)
+            sum -= it->second;
+    }
+    double mapTime = secondsSince(start);
+
+    cout << "window " << window << ": rangeVisit " << treeTime
+         << "s, std::map " << mapTime << "s (" << sum << ")" << endl;
+}
+
+// Benchmark: threads doing 99% lookups and 1% writes, the
+// persistent tree against RBTree behind one global mutex
+void benchmarkReadScaling(int numKeys, int opsPerThread) {
+    PersistentRBTree<int, int> persistent;
+    RBTree<int, int> locked;
+    mutex lock;
+    for (int i = 0; i < numKeys; i++) {
+        persistent.insert(2 * i, i);
+        locked.try_emplace_hint(NULL, 2 * i, i);
+    }
+
+    for (int threads = 1; threads <= 8; threads *= 2) {
+        double time[2];
+        for (int mode = 0; mode < 2; mode++) {
+            atomic<long long> found(0);
+            vector<thread> workers;
+            auto start = chrono::steady_clock::now();
+            for (int t = 0; t < threads; t++) {
+                workers.emplace_back([&, t] {
+                    mt19937 rng(t);
+                    long long hits = 0;
+                    int value;
+                    for (int i = 0; i < opsPerThread; i++) {
+                        int key = rng() % (2 * numKeys);
+                        bool write = i % 100 == 0;
+                        if (mode == 0 && write) {
+                            if (!persistent.erase(key))
+                                persistent.insert(key, i);
+                        } else if (mode == 0) {
+                            hits += persistent.find(key, value);
+                        } else {
+                            lock_guard<mutex> guard(lock);
+                            RBTree<int, int>::NodeType *x = locked.search(key);
+                            bool present = x != NULL && x->key == key;
+                            if (write && present)
+                                locked.deleteByVal(key);
+                            else if (write)
+                                locked.insert(key, i);
+                            else
+                                hits += present;
+                        }
+                    }
+                    found += hits;
+                });
+            }
+            for (thread &worker : workers)
+                worker.join();
+            time[mode] = secondsSince(start);
+        }
+        double ops = (double)threads * opsPerThread / 1e6;
+        cout << threads << " threads: persistent " << ops / time[0]
+             << " Mops/s, global mutex " << ops / time[1] << " Mops/s"
+             << endl;
+    }
+}
+
 int main() {
-    RBTree tree;
+    RBTree<int, int> tree;
 
     tree.insert(7);
     tree.insert(3);
@@ -500,5 +1436,32 @@ int main() {
 
     tree.printInOrder();
     tree.printLevelOrder();
+
+    cout << "Keys in [6, 13]: ";
+    tree.rangeVisit(6, 13, [](const int &key, int &) { cout << key << " "; });
+    cout << endl << "Backwards from upper_bound(8): ";
+    for (auto it = tree.upper_bound(8); it != tree.begin();) {
+        --it;
+        cout << it->key << " ";
+    }
+    cout << endl << endl;
+
+    // Erasing through an iterator leaves the others valid
+    auto held = tree.lower_bound(13);
+    cout << "Erasing even keys while holding 13" << endl;
+    for (auto it = tree.begin(); it != tree.end();) {
+        if (it->key % 2 == 0)
+            it = tree.erase(it);
+        else
+            ++it;
+    }
+    tree.printInOrder();
+    cout << "Held iterator: " << held->key << endl << endl;
+
+    benchmark(1000000);
+    benchmarkSortedIngest(4000000);
+    for (int window = 10; window <= 1000; window *= 10)
+        benchmarkWindows(4000000, window);
+    benchmarkReadScaling(1000000, 200000);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,602 @@
+// C Program to Implement a B+ Tree with string keys
+// Keys are byte strings compared with memcmp. Each node stores
+// the prefix shared by all of its keys once and only the rest
+// of every key after it, and a leaf split sends up the
+// shortest separator that still divides the two leaves, so a
+// node holds more keys and the tree gets shallower
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Bytes of key data a node may hold (prefix plus suffixes)
+#define NODE_BYTES 4096
+
+// Maximum number of keys in a node, whatever their size
+#define MAX_KEYS 255
+
+// Longest key accepted
+#define MAX_KEY_LEN 512
+
+typedef struct Node {
+    // To determine whether the node is leaf or not
+    bool leaf;
+    // Current number of keys
+    int n;
+    // The first prefixLen bytes of data are the prefix every
+    // key of the node starts with
+    int prefixLen;
+    // Bytes of data in use
+    int used;
+    // Key i is the prefix followed by len[i] bytes at
+    // data + off[i]. In an internal node the keys are
+    // separators, keys equal to one live in the right subtree
+    uint16_t off[MAX_KEYS + 1];
+    uint16_t len[MAX_KEYS + 1];
+    union {
+        // Array of child pointers
+        struct Node *children[MAX_KEYS + 2];
+        // Value stored with each key of a leaf
+        int values[MAX_KEYS + 1];
+    };
+    // Pointer to next leaf node
+    struct Node *next;
+    // Prefix and suffix bytes
+    char data[NODE_BYTES + MAX_KEY_LEN];
+} Node;
+
+typedef struct BTree {
+    // Pointer to root node
+    Node *root;
+    // false stores every key in full and promotes whole keys,
+    // to compare against
+    bool compress;
+    // Number of keys in the tree
+    long numKeys;
+    // Room to expand the keys of one node while rebuilding it
+    char *scratch;
+} BTree;
+
+// Keys of one node spelled out in full while it is rebuilt
+typedef struct KeyList {
+    const char *key[MAX_KEYS + 2];
+    int len[MAX_KEYS + 2];
+    int n;
+} KeyList;
+
+Node *createNode(bool leaf) {
+    Node *node = (Node *)malloc(sizeof(Node));
+    node->leaf = leaf;
+    node->n = 0;
+    node->prefixLen = 0;
+    node->used = 0;
+    node->next = NULL;
+    return node;
+}
+
+BTree *createBTree(bool compress) {
+    BTree *btree = (BTree *)malloc(sizeof(BTree));
+    btree->root = createNode(true);
+    btree->compress = compress;
+    btree->numKeys = 0;
+    btree->scratch = (char *)malloc((size_t)(MAX_KEYS + 2) * MAX_KEY_LEN);
+    return btree;
+}
+
+void freeTree(Node *node) {
+    if (!node->leaf) {
+        for (int i = 0; i <= node->n; i++) {
+            freeTree(node->children[i]);
+        }
+    }
+    free(node);
+}
+
+void destroyBTree(BTree *btree) {
+    freeTree(btree->root);
+    free(btree->scratch);
+    free(btree);
+}
+
+// Function to compare two byte strings, a shorter string
+// that is a prefix of the other sorts first
+int compareKeys(const char *a, int aLen, const char *b, int bLen) {
+    int c = memcmp(a, b, aLen < bLen ? aLen : bLen);
+    if (c != 0)
+        return c;
+    return aLen - bLen;
+}
+
+// Function to count the keys of a node smaller than key
+// (orEqual: smaller or equal). The prefix is compared once,
+// the binary search only looks at suffixes
+int nodeRank(Node *node, const char *key, int keyLen, bool orEqual) {
+    int p = node->prefixLen;
+    int c = memcmp(key, node->data, keyLen < p ? keyLen : p);
+    if (c < 0 || (c == 0 && keyLen < p))
+        return 0;
+    if (c > 0)
+        return node->n;
+    key += p;
+    keyLen -= p;
+    int lo = 0, hi = node->n;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        c = compareKeys(key, keyLen, node->data + node->off[mid], node->len[mid]);
+        if (c > 0 || (orEqual && c == 0))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// Function to check whether key i of a node equals key
+bool keyEquals(Node *node, int i, const char *key, int keyLen) {
+    int p = node->prefixLen;
+    return keyLen == p + node->len[i] && memcmp(key, node->data, p) == 0
+        && memcmp(key + p, node->data + node->off[i], node->len[i]) == 0;
+}
+
+// Function to write key i of a node in full to buf
+int nodeKey(Node *node, int i, char *buf) {
+    memcpy(buf, node->data, node->prefixLen);
+    memcpy(buf + node->prefixLen, node->data + node->off[i], node->len[i]);
+    return node->prefixLen + node->len[i];
+}
+
+// Function to spell out every key of a node into scratch
+void expandKeys(Node *node, char *scratch, KeyList *list) {
+    for (int i = 0; i < node->n; i++) {
+        list->key[i] = scratch;
+        list->len[i] = nodeKey(node, i, scratch);
+        scratch += list->len[i];
+    }
+    list->n = node->n;
+}
+
+// Function to find the bytes keys[from, to) share
+int commonPrefix(KeyList *list, int from, int to) {
+    if (from >= to)
+        return 0;
+    int prefix = list->len[from];
+    for (int i = from + 1; i < to && prefix > 0; i++) {
+        int j = 0;
+        while (j < prefix && j < list->len[i]
+            && list->key[i][j] == list->key[from][j])
+            j++;
+        prefix = j;
+    }
+    return prefix;
+}
+
+// Function to get the data bytes keys[from, to) would take
+int encodedSize(KeyList *list, int from, int to, bool compress) {
+    int prefix = compress ? commonPrefix(list, from, to) : 0;
+    int size = prefix;
+    for (int i = from; i < to; i++) {
+        size += list->len[i] - prefix;
+    }
+    return size;
+}
+
+// Function to store keys[from, to) in node, replacing its keys
+void encodeKeys(Node *node, KeyList *list, int from, int to, bool compress) {
+    assert(to - from <= MAX_KEYS && encodedSize(list, from, to, compress) <= NODE_BYTES);
+    int prefix = compress ? commonPrefix(list, from, to) : 0;
+    memcpy(node->data, list->key[from], prefix);
+    int used = prefix;
+    for (int i = from; i < to; i++) {
+        int k = i - from;
+        node->off[k] = (uint16_t)used;
+        node->len[k] = (uint16_t)(list->len[i] - prefix);
+        memcpy(node->data + used, list->key[i] + prefix, node->len[k]);
+        used += node->len[k];
+    }
+    node->n = to - from;
+    node->prefixLen = prefix;
+    node->used = used;
+}
+
+// Function to count the bytes two keys start with in common
+int sharedBytes(const char *a, int aLen, const char *b, int bLen) {
+    int i = 0;
+    while (i < aLen && i < bLen && a[i] == b[i])
+        i++;
+    return i;
+}
+
+// Function to get the data bytes keys[from, to) would take,
+// given total[i] = bytes of keys[0, i). The keys are sorted,
+// so the prefix they share is the one of the first and last
+int rangeSize(KeyList *list, const int *total, int from, int to, bool compress) {
+    if (from >= to)
+        return 0;
+    int prefix = compress ? sharedBytes(list->key[from], list->len[from],
+                                        list->key[to - 1], list->len[to - 1]) : 0;
+    return total[to] - total[from] - (to - from - 1) * prefix;
+}
+
+// Function to pick where an overflowing key list splits: the
+// left node takes keys[0, mid), the right one keys[mid + gap,
+// n), gap being 1 in an internal node whose middle key moves
+// up. Splitting by count can leave a half far over NODE_BYTES
+// once it loses the prefix the node shared, so every split is
+// sized and the one with the smallest larger half wins. A key
+// that broke the shared prefix sorts before or after all the
+// others, so splitting it off always leaves two halves that fit
+int chooseSplit(KeyList *list, int gap, bool compress) {
+    int total[MAX_KEYS + 3];
+    total[0] = 0;
+    for (int i = 0; i < list->n; i++) {
+        total[i + 1] = total[i] + list->len[i];
+    }
+    int best = -1, bestSize = 0;
+    for (int mid = 1; mid + gap < list->n; mid++) {
+        int leftSize = rangeSize(list, total, 0, mid, compress);
+        int rightSize = rangeSize(list, total, mid + gap, list->n, compress);
+        int larger = leftSize > rightSize ? leftSize : rightSize;
+        if (mid > MAX_KEYS || list->n - mid - gap > MAX_KEYS || larger > NODE_BYTES)
+            continue;
+        if (best < 0 || larger < bestSize) {
+            best = mid;
+            bestSize = larger;
+        }
+    }
+    assert(best >= 0);
+    return best;
+}
+
+// Function to add key at position pos of a key list
+void listInsert(KeyList *list, int pos, const char *key, int keyLen) {
+    for (int i = list->n; i > pos; i--) {
+        list->key[i] = list->key[i - 1];
+        list->len[i] = list->len[i - 1];
+    }
+    list->key[pos] = key;
+    list->len[pos] = keyLen;
+    list->n++;
+}
+
+bool overflows(KeyList *list, bool compress) {
+    return list->n > MAX_KEYS || encodedSize(list, 0, list->n, compress) > NODE_BYTES;
+}
+
+// Function to add key at position pos without rebuilding the
+// node: works when key starts with the node's prefix and its
+// suffix still fits, the suffix is appended to data
+bool insertInPlace(Node *node, int pos, const char *key, int keyLen) {
+    int p = node->prefixLen;
+    if (node->n >= MAX_KEYS || keyLen < p || memcmp(key, node->data, p) != 0
+        || node->used + keyLen - p > NODE_BYTES)
+        return false;
+    for (int i = node->n; i > pos; i--) {
+        node->off[i] = node->off[i - 1];
+        node->len[i] = node->len[i - 1];
+    }
+    node->off[pos] = (uint16_t)node->used;
+    node->len[pos] = (uint16_t)(keyLen - p);
+    memcpy(node->data + node->used, key + p, keyLen - p);
+    node->used += keyLen - p;
+    node->n++;
+    return true;
+}
+
+// Function to pick the separator pushed up by a leaf split:
+// the shortest prefix of the right leaf's first key that is
+// still greater than the left leaf's last key
+int truncateSeparator(const char *left, int leftLen, const char *right,
+    int rightLen) {
+    int i = 0;
+    while (i < leftLen && i < rightLen && left[i] == right[i])
+        i++;
+    return i + 1 <= rightLen ? i + 1 : rightLen;
+}
+
+// Function to insert a key below node. If node had to split,
+// the new right sibling is returned and its separator written
+// to sep, otherwise NULL
+Node *insertRec(BTree *btree, Node *node, const char *key, int keyLen,
+    int value, char *sep, int *sepLen) {
+    KeyList list;
+    if (node->leaf) {
+        int pos = nodeRank(node, key, keyLen, false);
+        if (pos < node->n && keyEquals(node, pos, key, keyLen)) {
+            node->values[pos] = value;
+            return NULL;
+        }
+        btree->numKeys++;
+        for (int i = node->n; i > pos; i--) {
+            node->values[i] = node->values[i - 1];
+        }
+        node->values[pos] = value;
+        if (insertInPlace(node, pos, key, keyLen))
+            return NULL;
+
+        // Rebuild: the prefix shrinks or the node splits
+        expandKeys(node, btree->scratch, &list);
+        listInsert(&list, pos, key, keyLen);
+        if (!overflows(&list, btree->compress)) {
+            encodeKeys(node, &list, 0, list.n, btree->compress);
+            return NULL;
+        }
+
+        // Split by size, the right half moves to a new leaf
+        int mid = chooseSplit(&list, 0, btree->compress);
+        Node *right = createNode(true);
+        for (int i = mid; i < list.n; i++) {
+            right->values[i - mid] = node->values[i];
+        }
+        if (btree->compress) {
+            *sepLen = truncateSeparator(list.key[mid - 1], list.len[mid - 1],
+                list.key[mid], list.len[mid]);
+        } else {
+            *sepLen = list.len[mid];
+        }
+        memcpy(sep, list.key[mid], *sepLen);
+        encodeKeys(right, &list, mid, list.n, btree->compress);
+        encodeKeys(node, &list, 0, mid, btree->compress);
+        right->next = node->next;
+        node->next = right;
+        return right;
+    }
+
+    int idx = nodeRank(node, key, keyLen, true);
+    char childSep[MAX_KEY_LEN];
+    int childSepLen;
+    Node *newChild = insertRec(btree, node->children[idx], key, keyLen, value,
+        childSep, &childSepLen);
+    if (newChild == NULL)
+        return NULL;
+
+    // Child split: add its separator and the new child
+    for (int i = node->n + 1; i > idx + 1; i--) {
+        node->children[i] = node->children[i - 1];
+    }
+    node->children[idx + 1] = newChild;
+    if (insertInPlace(node, idx, childSep, childSepLen))
+        return NULL;
+    expandKeys(node, btree->scratch, &list);
+    listInsert(&list, idx, childSep, childSepLen);
+    if (!overflows(&list, btree->compress)) {
+        encodeKeys(node, &list, 0, list.n, btree->compress);
+        return NULL;
+    }
+
+    // Split an internal node by size, the separator between
+    // the halves moves up
+    int mid = chooseSplit(&list, 1, btree->compress);
+    Node *right = createNode(false);
+    for (int i = mid + 1; i <= list.n; i++) {
+        right->children[i - mid - 1] = node->children[i];
+    }
+    *sepLen = list.len[mid];
+    memcpy(sep, list.key[mid], *sepLen);
+    encodeKeys(right, &list, mid + 1, list.n, btree->compress);
+    encodeKeys(node, &list, 0, mid, btree->compress);
+    return right;
+}
+
+// Function to insert a key, or update its value
+bool insert(BTree *btree, const char *key, int value) {
+    int keyLen = (int)strlen(key);
+    if (keyLen > MAX_KEY_LEN) {
+        printf("Key longer than %d bytes not inserted.\n", MAX_KEY_LEN);
+        return false;
+    }
+    char sep[MAX_KEY_LEN];
+    int sepLen;
+    Node *right = insertRec(btree, btree->root, key, keyLen, value, sep, &sepLen);
+    if (right != NULL) {
+        Node *newRoot = createNode(false);
+        KeyList list = {{sep}, {sepLen}, 1};
+        encodeKeys(newRoot, &list, 0, 1, btree->compress);
+        newRoot->children[0] = btree->root;
+        newRoot->children[1] = right;
+        btree->root = newRoot;
+    }
+    return true;
+}
+
+// Function to find the leaf that holds key
+Node *findLeaf(BTree *btree, const char *key, int keyLen) {
+    Node *node = btree->root;
+    while (!node->leaf) {
+        node = node->children[nodeRank(node, key, keyLen, true)];
+    }
+    return node;
+}
+
+// Function to find the position of key in its leaf, -1 if it
+// is not there
+int findInLeaf(Node *leaf, const char *key, int keyLen) {
+    int pos = nodeRank(leaf, key, keyLen, false);
+    if (pos < leaf->n && keyEquals(leaf, pos, key, keyLen))
+        return pos;
+    return -1;
+}
+
+// Function to search a key, its value goes to *value
+bool search(BTree *btree, const char *key, int *value) {
+    int keyLen = (int)strlen(key);
+    Node *leaf = findLeaf(btree, key, keyLen);
+    int pos = findInLeaf(leaf, key, keyLen);
+    if (pos < 0)
+        return false;
+    if (value != NULL)
+        *value = leaf->values[pos];
+    return true;
+}
+
+// Function to delete a key from its leaf. Leaves are not
+// merged, the separators above still route correctly
+bool deleteKey(BTree *btree, const char *key) {
+    int keyLen = (int)strlen(key);
+    Node *leaf = findLeaf(btree, key, keyLen);
+    int pos = findInLeaf(leaf, key, keyLen);
+    if (pos < 0)
+        return false;
+    KeyList list;
+    expandKeys(leaf, btree->scratch, &list);
+    for (int i = pos + 1; i < list.n; i++) {
+        list.key[i - 1] = list.key[i];
+        list.len[i - 1] = list.len[i];
+        leaf->values[i - 1] = leaf->values[i];
+    }
+    list.n--;
+    if (list.n > 0) {
+        encodeKeys(leaf, &list, 0, list.n, btree->compress);
+    } else {
+        leaf->n = leaf->prefixLen = leaf->used = 0;
+    }
+    btree->numKeys--;
+    return true;
+}
+
+// Function to call callback for every key in [lo, hi] in
+// ascending order, stops early if callback returns false.
+// Returns the number of keys visited
+int rangeScan(BTree *btree, const char *lo, const char *hi,
+    bool (*callback)(const char *key, int value, void *arg), void *arg) {
+    int loLen = (int)strlen(lo), hiLen = (int)strlen(hi);
+    char key[MAX_KEY_LEN + 1];
+    int count = 0;
+    Node *leaf = findLeaf(btree, lo, loLen);
+    int i = nodeRank(leaf, lo, loLen, false);
+    for (; leaf != NULL; leaf = leaf->next, i = 0) {
+        for (; i < leaf->n; i++) {
+            int len = nodeKey(leaf, i, key);
+            if (compareKeys(key, len, hi, hiLen) > 0)
+                return count;
+            key[len] = '\0';
+            count++;
+            if (!callback(key, leaf->values[i], arg))
+                return count;
+        }
+    }
+    return count;
+}
+
+// Size figures of a tree
+typedef struct TreeStats {
+    int height;
+    long nodes, leaves;
+    // Key bytes stored in all nodes
+    long keyBytes;
+} TreeStats;
+
+void collectStats(Node *node, int depth, TreeStats *stats) {
+    stats->nodes++;
+    stats->keyBytes += node->used;
+    if (depth > stats->height)
+        stats->height = depth;
+    if (node->leaf) {
+        stats->leaves++;
+        return;
+    }
+    for (int i = 0; i <= node->n; i++) {
+        collectStats(node->children[i], depth + 1, stats);
+    }
+}
+
+bool printKey(const char *key, int value, void *arg) {
+    (void)arg;
+    printf("  %s -> %d\n", key, value);
+    return true;
+}
+
+// Benchmark: URL keys with long shared prefixes, with and
+// without compression
+void benchmarkUrls(int numKeys) {
+    char (*urls)[96] = malloc(sizeof(*urls) * numKeys);
+    for (int i = 0; i < numKeys; i++) {
+        unsigned int x = (unsigned int)i * 2654435761u;
+        snprintf(urls[i], sizeof(urls[i]),
+            "https://www.example.com/catalog/category-%03u/product-%08u.html",
+            x % 500, x);
+    }
+
+    for (int compress = 1; compress >= 0; compress--) {
+        BTree *btree = createBTree(compress);
+        clock_t start = clock();
+        for (int i = 0; i < numKeys; i++) {
+            insert(btree, urls[i], i);
+        }
+        double buildTime = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        start = clock();
+        long found = 0;
+        for (int i = 0; i < numKeys; i++) {
+            found += search(btree, urls[(i * 7919L) % numKeys], NULL);
+        }
+        double lookupTime = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        TreeStats stats = {0, 0, 0, 0};
+        collectStats(btree->root, 1, &stats);
+        printf("%s: height %d, %ld nodes, %.1f keys/leaf, "
+               "%.1f MB key bytes, %.1f MB nodes\n"
+               "  build %.2fs, %.2f Mlookups/s (%ld found)\n",
+            compress ? "prefix/suffix compressed" : "uncompressed",
+            stats.height, stats.nodes, (double)btree->numKeys / stats.leaves,
+            stats.keyBytes / 1e6, stats.nodes * sizeof(Node) / 1e6, buildTime,
+            numKeys / lookupTime / 1e6, found);
+        destroyBTree(btree);
+    }
+    free(urls);
+}
+
+// Test: keys sharing a 400-byte prefix fill a leaf compactly,
+// then a key without that prefix lands next to them. Split by
+// count, the half holding it would need about 20KB of data
+bool testLostPrefixSplit() {
+    BTree *btree = createBTree(true);
+    char key[MAX_KEY_LEN + 1];
+    memset(key, 'p', 400);
+    for (int i = 0; i < 100; i++) {
+        snprintf(key + 400, sizeof(key) - 400, "%03d", i);
+        insert(btree, key, i);
+    }
+    insert(btree, "a", 100);
+    insert(btree, "q", 101);
+
+    bool ok = btree->numKeys == 102;
+    int value;
+    for (int i = 0; i < 100; i++) {
+        snprintf(key + 400, sizeof(key) - 400, "%03d", i);
+        ok = ok && search(btree, key, &value) && value == i;
+    }
+    ok = ok && search(btree, "a", &value) && value == 100;
+    ok = ok && search(btree, "q", &value) && value == 101;
+    destroyBTree(btree);
+    return ok;
+}
+
+int main() {
+    BTree *btree = createBTree(true);
+    const char *paths[] = {"/usr/lib/libc.so", "/usr/lib/libm.so",
+        "/usr/lib/libpthread.so", "/usr/include/stdio.h", "/usr/include/stdlib.h",
+        "/usr/bin/gcc", "/usr/bin/g++", "/etc/passwd"};
+    for (int i = 0; i < 8; i++) {
+        insert(btree, paths[i], i);
+    }
+    deleteKey(btree, "/usr/bin/g++");
+
+    int value;
+    if (search(btree, "/usr/include/stdio.h", &value))
+        printf("Key /usr/include/stdio.h found, value %d\n", value);
+    printf("Key /usr/bin/g++ %s\n",
+        search(btree, "/usr/bin/g++", NULL) ? "found" : "not found");
+    printf("Keys in [/usr/include, /usr/lib/libm.so]:\n");
+    rangeScan(btree, "/usr/include", "/usr/lib/libm.so", printKey, NULL);
+    printf("\n");
+    destroyBTree(btree);
+
+    printf("Split after a lost prefix: %s\n\n",
+        testLostPrefixSplit() ? "passed" : "FAILED");
+
+    benchmarkUrls(1000000);
+    return 0;
+}